@@ -0,0 +1,145 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Hi-Z Labs, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "FatFs-Async.h"
+#include <mutex>
+
+#if PLATFORM_THREADING
+
+LOG_SOURCE_CATEGORY("fatfs.async")
+
+std::atomic<os_queue_t> FatFsAsync::_queue(nullptr);
+os_thread_t FatFsAsync::_thread = nullptr;
+static std::mutex _beginMutex;
+
+FatFsRequest::FatFsRequest(FatFsOperation operation, FatFsCallback callback) :
+	_operation(operation),
+	_callback(callback),
+	_signal(nullptr),
+	_done(false),
+	_result(FR_OK),
+	_transferred(0)
+{
+	os_queue_create(&_signal, 0, 1, nullptr);
+}
+
+FatFsRequest::~FatFsRequest()
+{
+	if(_signal != nullptr)
+		os_queue_destroy(_signal, nullptr);
+}
+
+void FatFsRequest::complete(FRESULT result, UINT transferred)
+{
+	_result = result;
+	_transferred = transferred;
+	if(_callback)
+		_callback(result, transferred);
+	_done = true;
+	os_queue_put(_signal, nullptr, 0, nullptr);
+}
+
+FRESULT FatFsRequest::wait(system_tick_t timeout)
+{
+	if(!_done && os_queue_take(_signal, nullptr, timeout, nullptr) != 0)
+		return FR_TIMEOUT;
+	return _result;
+}
+
+bool FatFsAsync::begin(size_t queueDepth, os_thread_prio_t priority, size_t stackSize)
+{
+	std::lock_guard<std::mutex> lock(_beginMutex);
+	if(_queue != nullptr)
+		return true;
+
+	os_queue_t queue = nullptr;
+	if(os_queue_create(&queue, sizeof(FatFsRequestHandle*), queueDepth, nullptr) != 0)
+	{
+		LOG(ERROR, "could not create request queue");
+		return false;
+	}
+
+	if(os_thread_create(&_thread, "fatfs", priority, run, queue, stackSize) != 0)
+	{
+		LOG(ERROR, "could not create I/O thread");
+		os_queue_destroy(queue, nullptr);
+		_thread = nullptr;
+		return false;
+	}
+	_queue = queue;	//published only once the I/O thread exists
+	return true;
+}
+
+void FatFsAsync::run(void* param)
+{
+	os_queue_t queue = (os_queue_t)param;
+	for(;;)
+	{
+		FatFsRequestHandle* item;
+		if(os_queue_take(queue, &item, CONCURRENT_WAIT_FOREVER, nullptr) != 0)
+			continue;
+
+		UINT transferred = 0;
+		FRESULT result = (*item)->_operation(transferred);
+		(*item)->complete(result, transferred);
+		delete item;	//releases the I/O thread's reference to the request
+	}
+}
+
+FatFsRequestHandle FatFsAsync::submit(FatFsOperation operation, FatFsCallback callback)
+{
+	if(_queue == nullptr && !begin())
+		return nullptr;
+
+	FatFsRequestHandle request(new (std::nothrow) FatFsRequest(operation, callback));
+	if(!request || request->_signal == nullptr)
+		return nullptr;
+
+	FatFsRequestHandle* item = new (std::nothrow) FatFsRequestHandle(request);
+	if(item == nullptr)
+		return nullptr;
+
+	if(os_queue_put(_queue, &item, 0, nullptr) != 0)	//never blocks the caller; a full queue fails the request
+	{
+		delete item;
+		return nullptr;
+	}
+	return request;
+}
+
+FatFsRequestHandle FatFsAsync::read(FIL* fp, void* buff, UINT btr, FatFsCallback callback)
+{
+	return submit([=](UINT& br) { return f_read(fp, buff, btr, &br); }, callback);
+}
+
+FatFsRequestHandle FatFsAsync::write(FIL* fp, const void* buff, UINT btw, FatFsCallback callback)
+{
+	return submit([=](UINT& bw) { return f_write(fp, buff, btw, &bw); }, callback);
+}
+
+FatFsRequestHandle FatFsAsync::sync(FIL* fp, FatFsCallback callback)
+{
+	return submit([=](UINT&) { return f_sync(fp); }, callback);
+}
+
+#endif
@@ -0,0 +1,91 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Hi-Z Labs, LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FATFS_PARTICLE_ASYNC_H_
+#define FATFS_PARTICLE_ASYNC_H_
+
+#ifndef __cplusplus
+#error "FatFsAsync must be included only in C++"
+#else
+
+#include <FatFs/FatFs.h>
+#include <functional>
+#include <memory>
+#include <atomic>
+
+#if PLATFORM_THREADING
+
+typedef std::function<FRESULT(UINT&)> FatFsOperation;
+typedef std::function<void(FRESULT, UINT)> FatFsCallback;
+
+/*! \brief Pollable handle of a request submitted to the FatFs I/O thread
+ *
+ *  The handle stays valid after the request completes. wait() blocks the calling thread until the
+ *  I/O thread has finished the request (and its callback, if any). Only one thread should wait on
+ *  a request at a time.
+ */
+class FatFsRequest {
+	FatFsOperation _operation;
+	FatFsCallback _callback;
+	os_queue_t _signal;
+	std::atomic<bool> _done;
+	volatile FRESULT _result;
+	volatile UINT _transferred;
+	friend class FatFsAsync;
+
+	FatFsRequest(FatFsOperation operation, FatFsCallback callback);
+	void complete(FRESULT result, UINT transferred);
+public:
+	~FatFsRequest();
+	bool done() const { return _done; }
+	FRESULT result() const { return _result; }
+	UINT transferred() const { return _transferred; }
+	FRESULT wait(system_tick_t timeout = CONCURRENT_WAIT_FOREVER);
+};
+
+typedef std::shared_ptr<FatFsRequest> FatFsRequestHandle;
+
+/*! \brief Asynchronous file I/O serviced by a dedicated thread
+ *
+ *  Requests are executed in submission order by a single I/O thread, which blocks on the DMA
+ *  completion of the SD driver while application threads keep running. The buffer passed to
+ *  read() or write() must remain valid, and the file object must not be used by other threads,
+ *  until the request completes. Callbacks run on the I/O thread and should return quickly.
+ *  Submitting never blocks: a null handle is returned when the request could not be queued, e.g.
+ *  because queueDepth requests are already pending.
+ */
+class FatFsAsync {
+	static std::atomic<os_queue_t> _queue;
+	static os_thread_t _thread;
+	static void run(void* param);
+public:
+	static bool begin(size_t queueDepth = 8, os_thread_prio_t priority = OS_THREAD_PRIORITY_DEFAULT, size_t stackSize = 3072);
+	static FatFsRequestHandle submit(FatFsOperation operation, FatFsCallback callback = nullptr);
+	static FatFsRequestHandle read(FIL* fp, void* buff, UINT btr, FatFsCallback callback = nullptr);
+	static FatFsRequestHandle write(FIL* fp, const void* buff, UINT btw, FatFsCallback callback = nullptr);
+	static FatFsRequestHandle sync(FIL* fp, FatFsCallback callback = nullptr);
+};
+
+#endif
+#endif
+#endif /* FATFS_PARTICLE_ASYNC_H_ */
@@ -49,11 +49,25 @@ extern "C" void __ff_spi_send_dma(SPIClass& spi, const BYTE* buff, const UINT bt
 }
 
 
+#if PLATFORM_THREADING
+//a block of dummy bytes sent while receiving, so the receive buffer does not need to be filled before each transfer
+//(initialized at compile time, so concurrent first transfers never see it half filled)
+#define DUMMY_FF_8	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+#define DUMMY_FF_64	DUMMY_FF_8, DUMMY_FF_8, DUMMY_FF_8, DUMMY_FF_8, DUMMY_FF_8, DUMMY_FF_8, DUMMY_FF_8, DUMMY_FF_8
+static BYTE dummyBlock[512] = { DUMMY_FF_64, DUMMY_FF_64, DUMMY_FF_64, DUMMY_FF_64, DUMMY_FF_64, DUMMY_FF_64, DUMMY_FF_64, DUMMY_FF_64 };
+#undef DUMMY_FF_64
+#undef DUMMY_FF_8
+#endif
+
 extern "C" void __ff_spi_receive_dma(SPIClass& spi, BYTE* buff, const UINT btr, const BYTE sendByte) {
 	/* Read multiple bytes, send 0xFF as dummy */
-	memset(buff, sendByte, btr);
-
 #if PLATFORM_THREADING
+	BYTE* txBuff = buff;
+	if(sendByte == 0xFF && btr <= sizeof(dummyBlock))
+		txBuff = dummyBlock;
+	else
+		memset(buff, sendByte, btr);
+
 #ifdef SYSTEM_VERSION_060
 	//use a queue to signal because the firmware implementation at the time of writing
 	//checks to use the ISR version of put when appropriate
@@ -69,7 +83,7 @@ extern "C" void __ff_spi_receive_dma(SPIClass& spi, BYTE* buff, const UINT btr,
 #ifndef SYSTEM_VERSION_060
 		signal.lock();
 #endif
-		spi.transfer(buff, buff, btr, callback);
+		spi.transfer(txBuff, buff, btr, callback);
 
 #ifdef SYSTEM_VERSION_060
 		os_queue_take(signal, nullptr, CONCURRENT_WAIT_FOREVER, nullptr);
@@ -113,7 +113,7 @@ private:
 		{
 			BYTE n, res;
 
-			if(!wait_ready(10))
+			if(cmd != CMD12 && !wait_ready(10))	/* The card is still streaming data when a multiple block read is stopped */
 				LOG(ERROR, "SD: wait_ready before cmd failed");
 
 			if (cmd & 0x80) {	/* Send a CMD55 prior to ACMD<n> */
@@ -428,21 +428,28 @@ public:
 		if (!cardPresent() || (_status & STA_NOINIT))
 			return RES_NOTRDY;
 
-		if (!(_cardType & CT_BLOCK))
-			sector *= 512;						/* LBA ot BA conversion (byte addressing cards) */
+		while(count != 0) {
+			BYTE cmd = count > 1 ? CMD18 : CMD17;	/* READ_MULTIPLE_BLOCK or READ_SINGLE_BLOCK */
+			DWORD address = sector + read;
+			if (!(_cardType & CT_BLOCK))
+				address *= 512;						/* LBA ot BA conversion (byte addressing cards) */
 
-		while(count != 0) {						/* Single sector read */
-			if(send_cmd(CMD17, sector) == 0)	/* READ_SINGLE_BLOCK */
+			if(send_cmd(cmd, address) == 0)
 			{
-				if(rcvr_datablock(buff + 512 * read, 512)) {
+				do {								/* The card streams the following blocks without further commands */
+					if(!rcvr_datablock(buff + 512 * read, 512)) {
+						LOG(ERROR, "SD: Read failed for sector %d", sector + read);
+						break;
+					}
 					count--;
 					read++;
-				} else
-					LOG(ERROR, "SD: Read failed for sector %d", sector);
+				} while(cmd == CMD18 && count != 0);
+				if(cmd == CMD18)
+					send_cmd(CMD12, 0);				/* STOP_TRANSMISSION */
 			}
 			else
 			{
-				LOG(ERROR, "SD: CMD17 not accepted, re-init");
+				LOG(ERROR, "SD: CMD%d not accepted, re-init", cmd);
 				deselect();
 				this->unlock();
 				initialize();
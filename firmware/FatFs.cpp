@@ -18,6 +18,8 @@
 /----------------------------------------------------------------------------*/
 
 #include "FatFs.h"
+#include <new>
+#include <algorithm>
 
 LOG_SOURCE_CATEGORY("fatfs.diskio");
 
@@ -71,9 +73,16 @@ extern "C" DWORD get_fattime(void) {
 			| ((DWORD)Time.second() >> 1);				/* Sec 0 */
 }
 
+#if _FS_WRITEBEHIND
+extern "C" DWORD ff_tick(void) {
+	/* Returns milliseconds for the write-behind age limit */
+	return millis();
+}
+#endif
+
 std::vector<FatFsDriver*> FatFs::_drivers;
 
-FRESULT FatFs::attach(FatFsDriver& driver, BYTE driveNumber)
+FRESULT FatFs::attach(FatFsDriver& driver, BYTE driveNumber, UINT fatCacheSectors, UINT dirCacheSectors, UINT burstSectors)
 {
 	LOG(INFO, "attaching drive %d", driveNumber);
 	while(driveNumber >= _drivers.size())
@@ -84,6 +93,23 @@ FRESULT FatFs::attach(FatFsDriver& driver, BYTE driveNumber)
 
 	_drivers[driveNumber] = &driver;
 
+#if _FS_WINCACHE
+	UINT cacheSectors = fatCacheSectors + dirCacheSectors;
+	driver._cache.reset(cacheSectors ? new (std::nothrow) WCSLOT[cacheSectors] : nullptr);
+	if(cacheSectors && !driver._cache)
+		LOG(WARN, "no memory for %u cache sectors, drive %d runs uncached", cacheSectors, driveNumber);
+	if(driver._cache)
+		f_setcache(&driver.fs, driver._cache.get(), fatCacheSectors, dirCacheSectors);
+	else
+		f_setcache(&driver.fs, nullptr, 0, 0);
+#endif
+#if _FS_BURSTBUF
+	driver._burst.reset(burstSectors ? new (std::nothrow) BYTE[burstSectors * _MAX_SS] : nullptr);
+	if(burstSectors && !driver._burst)
+		LOG(WARN, "no memory for %u burst sectors on drive %d", burstSectors, driveNumber);
+	f_setburst(&driver.fs, driver._burst.get(), driver._burst ? burstSectors : 0);
+#endif
+
 	char path[3];
 	path[0] = '0' + driveNumber;
 	path[1] = ':';
@@ -94,11 +120,33 @@ FRESULT FatFs::attach(FatFsDriver& driver, BYTE driveNumber)
 
 	if(result != FR_OK) {
 		_drivers[driveNumber] = nullptr;
+#if _FS_WINCACHE
+		f_setcache(&driver.fs, nullptr, 0, 0);
+		driver._cache.reset();
+#endif
+#if _FS_BURSTBUF
+		f_setburst(&driver.fs, nullptr, 0);
+		driver._burst.reset();
+#endif
 		return result;
 	}
 
 	_drivers[driveNumber]->_driveNumber = driveNumber;
 
+#if _FS_FREEMAP
+	UINT mapWords = std::min<UINT>((driver.fs.n_fatent + 31) / 32, _FS_FREEMAP / 4);
+	driver._freemap.reset(new (std::nothrow) DWORD[mapWords]);
+	if(!driver._freemap)
+		LOG(WARN, "no memory for %u byte free cluster map on drive %d", mapWords * 4, driveNumber);
+	f_setfreemap(path, driver._freemap.get(), driver._freemap ? mapWords : 0);
+#endif
+#if _FS_DIRINDEX
+	driver._dirindex.reset(new (std::nothrow) BYTE[_FS_DIRINDEX_SIZE]);
+	if(!driver._dirindex)
+		LOG(WARN, "no memory for %u byte directory index on drive %d", _FS_DIRINDEX_SIZE, driveNumber);
+	f_setdirindex(path, driver._dirindex.get(), driver._dirindex ? _FS_DIRINDEX_SIZE : 0);
+#endif
+
 	return result;
 }
 
@@ -108,10 +156,31 @@ void FatFs::detach(BYTE driveNumber)
 	if(driver != nullptr && driver->_attached)
 	{
 		char path[3];
-		path[0] = driveNumber;
+		path[0] = '0' + driveNumber;
 		path[1] = ':';
 		path[2] = 0;
-		f_mount(nullptr, path, 0);
+		FRESULT result = f_mount(nullptr, path, 0);
+		if(result == FR_TIMEOUT)
+		{
+			LOG(ERROR, "drive %d is busy and was not detached", driveNumber);
+			return;
+		}
+		if(result != FR_OK)
+			LOG(ERROR, "drive %d detached with unwritten metadata: %s", driveNumber, fileResultMessage(result));
+#if _FS_WINCACHE
+		f_setcache(&driver->fs, nullptr, 0, 0);
+		driver->_cache.reset();
+#endif
+#if _FS_BURSTBUF
+		f_setburst(&driver->fs, nullptr, 0);
+		driver->_burst.reset();
+#endif
+#if _FS_FREEMAP
+		driver->_freemap.reset();
+#endif
+#if _FS_DIRINDEX
+		driver->_dirindex.reset();
+#endif
 		_drivers[driveNumber] = nullptr;
 		driver->_driveNumber = DRIVE_NOT_ATTACHED;
 	}
@@ -223,6 +292,20 @@ extern "C" FRESULT f_getline(FIL* fp, TCHAR* buf, int len)
 	return result;
 }
 
+#if _USE_FORWARD
+static UINT forward_func(void* ctx, const BYTE* buf, UINT btf)
+{
+	return (*(const std::function<UINT(const BYTE*, UINT)>*)ctx)(buf, btf);
+}
+
+//func is called with (nullptr, 0) to sense whether the stream is ready, and then with spans of the file data; it returns
+//the number of bytes accepted (which may be fewer than offered for backpressure) or 0 to abort with FR_INT_ERR
+FRESULT f_forward_func(FIL* fp, const std::function<UINT(const BYTE*, UINT)>& func, UINT btf, UINT* bf)
+{
+	return f_forward_ctx(fp, forward_func, (void*)&func, btf, bf);
+}
+#endif
+
 inline uint32_t timeBetween(uint32_t past, uint32_t future) { return past <= future ? future - past : UINT32_MAX - past + future; }
 
 struct __ff_mutexes
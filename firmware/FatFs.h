@@ -23,6 +23,7 @@
 #include "ff.h"
 #include <vector>
 #include <memory>
+#include <functional>
 
 #ifndef LOG_SOURCE_CATEGORY
 #define LOG_SOURCE_CATEGORY(x)
@@ -50,6 +51,18 @@ class FatFs;
 class FatFsDriver {
 private:
 	FATFS fs;
+#if _FS_WINCACHE
+	std::unique_ptr<WCSLOT[]> _cache;
+#endif
+#if _FS_BURSTBUF
+	std::unique_ptr<BYTE[]> _burst;
+#endif
+#if _FS_FREEMAP
+	std::unique_ptr<DWORD[]> _freemap;
+#endif
+#if _FS_DIRINDEX
+	std::unique_ptr<BYTE[]> _dirindex;
+#endif
 	bool _attached;
 	BYTE _driveNumber;
 	friend class FatFs;
@@ -77,7 +90,7 @@ private:
 	friend DRESULT disk_write(BYTE pdrv, const BYTE* buff, DWORD sector, UINT count);
 	friend DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void* buff);
 public:
-	static FRESULT attach(FatFsDriver& driver, BYTE driveNumber);
+	static FRESULT attach(FatFsDriver& driver, BYTE driveNumber, UINT fatCacheSectors = _FS_FATCACHE, UINT dirCacheSectors = _FS_DIRCACHE, UINT burstSectors = _FS_BURSTBUF);
 	static void detach(BYTE driveNumber);
 	static const char* fileResultMessage(FRESULT fileResult) { return FR_string(fileResult); }
 	static FatFsDriver* driver(BYTE pdrv) { return _drivers[pdrv]; }
@@ -85,8 +98,12 @@ public:
 
 extern "C" FRESULT f_copy(const char* src, const char* dst);
 extern "C" FRESULT f_getline(FIL* fp, TCHAR* buf, int len);
+#if _USE_FORWARD
+FRESULT f_forward_func(FIL* fp, const std::function<UINT(const BYTE*, UINT)>& func, UINT btf, UINT* bf);
+#endif
 
 #include "FatFs-SD.h"
+#include "FatFs-Async.h"
 
 #endif /* FATFS_PARTICLE_H_ */
 
@@ -34,6 +34,16 @@
 
 
 #define	ABORT(fs, res)		{ fp->err = (BYTE)(res); LEAVE_FF(fs, res); }
+#if _FS_READAHEAD
+#define	RA_READ(fp, sect)	ra_read(fp, sect)
+#else
+#define	RA_READ(fp, sect)	disk_read((fp)->obj.fs->drv, (fp)->buf, sect, 1)
+#endif
+#if _FS_WRITEBEHIND
+#define	WB_PUT(fp)			wb_put(fp)
+#else
+#define	WB_PUT(fp)			disk_write((fp)->obj.fs->drv, (fp)->buf, (fp)->sect, 1)
+#endif
 
 
 /* Reentrancy related */
@@ -72,6 +82,45 @@
 #endif
 
 
+/* Sector cache and FAT mirroring */
+#if _FS_WINCACHE && _FS_TINY
+#error _FS_WINCACHE cannot be used at tiny buffer configuration
+#endif
+#if _FS_WINCACHE && _FS_READONLY
+#error _FS_WINCACHE must be 0 at read-only configuration
+#endif
+#if _FS_LAZYMIRROR && _FS_READONLY
+#error _FS_LAZYMIRROR must be 0 at read-only configuration
+#endif
+#if _FS_GETFREE_NB && (_FS_READONLY || _FS_MINIMIZE != 0)
+#error _FS_GETFREE_NB requires _FS_READONLY == 0 and _FS_MINIMIZE == 0
+#endif
+#if _FS_LINKMAP && (!_USE_FASTSEEK || _FS_LINKMAP_SIZE < 4)
+#error _FS_LINKMAP requires _USE_FASTSEEK == 1 and _FS_LINKMAP_SIZE >= 4
+#endif
+#if _FS_PREALLOC && (_FS_READONLY || _FS_PREALLOC_FILES < 1)
+#error _FS_PREALLOC requires _FS_READONLY == 0 and _FS_PREALLOC_FILES >= 1
+#endif
+#if _FS_DIRINDEX && _USE_LFN != 0
+#error _FS_DIRINDEX is available only at non-LFN configuration
+#endif
+#if _FS_DIRHINT && _USE_LFN != 0
+#error _FS_DIRHINT is available only at non-LFN configuration
+#endif
+#if _FS_PATHCACHE && _USE_LFN != 0
+#error _FS_PATHCACHE is available only at non-LFN configuration
+#endif
+#if _FS_FREEMAP && _FS_READONLY
+#error _FS_FREEMAP must be 0 at read-only configuration
+#endif
+#if _FS_READAHEAD && _FS_TINY
+#error _FS_READAHEAD requires _FS_TINY == 0
+#endif
+#if _FS_WRITEBEHIND && (_FS_READONLY || _FS_TINY)
+#error _FS_WRITEBEHIND requires _FS_READONLY == 0 and _FS_TINY == 0
+#endif
+
+
 /* File lock controls */
 #if _FS_LOCK != 0
 #if _FS_READONLY
@@ -865,31 +914,281 @@ void clear_lock (	/* Clear lock entries of the volume */
 /* Move/Flush disk access window in the file system object               */
 /*-----------------------------------------------------------------------*/
 #if !_FS_READONLY
+static
+FRESULT write_meta (	/* Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs,			/* File system object */
+	const BYTE* buf,	/* Sector data to be written */
+	DWORD sect,			/* Top sector number to write */
+	UINT n				/* Number of sectors to write (must not cross the end of the FAT area) */
+)
+{
+	UINT nf;
+
+
+	if (disk_write(fs->drv, buf, sect, n) != RES_OK) return FR_DISK_ERR;
+	if (sect - fs->fatbase < fs->fsize) {		/* Is it in the FAT area? */
+#if _FS_LAZYMIRROR
+		if (fs->n_fats >= 2) {					/* Defer the change to the FAT copies */
+			for ( ; n; n--, sect++) {
+				nf = (sect - fs->fatbase) >> fs->mshift;
+				fs->mdirty[nf / 8] |= 1 << (nf % 8);
+			}
+			return FR_OK;
+		}
+#endif
+		for (nf = fs->n_fats; nf >= 2; nf--) {	/* Reflect the change to all FAT copies */
+			sect += fs->fsize;
+			disk_write(fs->drv, buf, sect, n);
+		}
+	}
+	return FR_OK;
+}
+
+
 static
 FRESULT sync_window (	/* Returns FR_OK or FR_DISK_ERROR */
 	FATFS* fs			/* File system object */
 )
 {
-	DWORD wsect;
-	UINT nf;
 	FRESULT res = FR_OK;
 
 
 	if (fs->wflag) {	/* Write back the sector if it is dirty */
-		wsect = fs->winsect;	/* Current sector number */
-		if (disk_write(fs->drv, fs->win, wsect, 1) != RES_OK) {
-			res = FR_DISK_ERR;
-		} else {
-			fs->wflag = 0;
-			if (wsect - fs->fatbase < fs->fsize) {		/* Is it in the FAT area? */
-				for (nf = fs->n_fats; nf >= 2; nf--) {	/* Reflect the change to all FAT copies */
-					wsect += fs->fsize;
-					disk_write(fs->drv, fs->win, wsect, 1);
-				}
+		res = write_meta(fs, fs->win, fs->winsect, 1);
+		if (res == FR_OK) fs->wflag = 0;
+	}
+	return res;
+}
+#endif
+
+
+#if _FS_WINCACHE
+#define IS_FATSECT(fs, sect)	((sect) - (fs)->fatbase < (fs)->fsize)	/* Is the sector in the FAT area? */
+
+static
+WCSLOT* wc_pool (	/* Returns the cache pool for the sector */
+	FATFS* fs,		/* File system object */
+	DWORD sect,		/* Sector number */
+	UINT* n			/* Number of slots in the pool */
+)
+{
+	if (IS_FATSECT(fs, sect)) {	/* FAT cache */
+		*n = fs->n_fatc;
+		return fs->wcache;
+	}
+	*n = fs->n_dirc;			/* Directory cache */
+	return fs->wcache + fs->n_fatc;
+}
+
+
+static
+void wc_purge (		/* Discard cached copies of the sectors without write-back */
+	FATFS* fs,		/* File system object */
+	DWORD sect,		/* Top of the sector range */
+	UINT n			/* Number of sectors */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < fs->n_fatc + fs->n_dirc; i++) {
+		if (fs->wcache[i].sect - sect < n) {
+			fs->wcache[i].sect = 0xFFFFFFFF;
+			fs->wcache[i].flag = 0;
+			fs->wcache[i].stamp = 0;
+		}
+	}
+}
+
+
+static
+BYTE* wc_dirty (	/* Returns the buffer of the dirty sector (NULL:not dirty) */
+	FATFS* fs,		/* File system object */
+	DWORD sect,		/* Sector number to find */
+	BYTE** flag		/* Returns pointer to the dirty flag of the buffer */
+)
+{
+	UINT i;
+
+
+	if (fs->wflag && fs->winsect == sect) {
+		*flag = &fs->wflag; return fs->win;
+	}
+	for (i = 0; i < fs->n_fatc + fs->n_dirc; i++) {
+		if ((fs->wcache[i].flag & 1) && fs->wcache[i].sect == sect) {
+			*flag = &fs->wcache[i].flag; return fs->wcache[i].buf;
+		}
+	}
+	return 0;
+}
+
+
+static
+FRESULT wc_flush (	/* Write back the window and all dirty cache slots. Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs		/* File system object */
+)
+{
+	UINT i, n, nbuf;
+	DWORD sect, next;
+	BYTE *buf, *flag, *fl[2];
+
+
+	nbuf = 1;
+#if _FS_BURSTBUF
+	if (fs->bbuf) nbuf = fs->n_bbuf;
+#endif
+	for (next = 0; ; next = sect + n) {
+		/* Find the lowest dirty sector at or above next */
+		sect = 0xFFFFFFFF;
+		if (fs->wflag && fs->winsect >= next) sect = fs->winsect;
+		for (i = 0; i < fs->n_fatc + fs->n_dirc; i++) {
+			if ((fs->wcache[i].flag & 1) && fs->wcache[i].sect >= next && fs->wcache[i].sect < sect) sect = fs->wcache[i].sect;
+		}
+		if (sect == 0xFFFFFFFF) break;	/* No dirty sector left */
+
+		buf = wc_dirty(fs, sect, &fl[0]);
+		n = 1;
+#if _FS_BURSTBUF
+		/* Gather the following dirty sectors in the same area into the burst buffer */
+		while (n < nbuf && IS_FATSECT(fs, sect + n) == IS_FATSECT(fs, sect) && wc_dirty(fs, sect + n, &flag)) {
+			if (n == 1) mem_cpy(fs->bbuf, buf, SS(fs));
+			mem_cpy(fs->bbuf + n * SS(fs), wc_dirty(fs, sect + n, &flag), SS(fs));
+			n++;
+		}
+		if (n > 1) buf = fs->bbuf;
+#endif
+		if (write_meta(fs, buf, sect, n) != FR_OK) return FR_DISK_ERR;
+		for (i = 0; i < n; i++) {	/* Mark the run clean */
+			wc_dirty(fs, sect + i, &fl[1]);
+			*fl[1] &= ~1;
+		}
+	}
+	return FR_OK;
+}
+
+
+static
+FRESULT wc_stash (	/* Move the window into its cache pool. Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs		/* File system object */
+)
+{
+	UINT i, n;
+	WCSLOT *pl, *vs;
+
+
+	if (fs->winsect == 0xFFFFFFFF) return FR_OK;	/* Nothing to stash */
+	pl = wc_pool(fs, fs->winsect, &n);
+	if (!n) return sync_window(fs);			/* No slot for the region, just write it back */
+
+	for (vs = pl, i = 1; i < n; i++) {		/* Find the least recently used slot */
+		if (pl[i].stamp < vs->stamp) vs = &pl[i];
+	}
+	if (vs->flag & 1) {						/* Write back all dirty sectors if the victim is dirty */
+		if (wc_flush(fs) != FR_OK) return FR_DISK_ERR;
+	}
+	mem_cpy(vs->buf, fs->win, SS(fs));
+	vs->sect = fs->winsect; vs->flag = fs->wflag; vs->stamp = ++fs->wcstamp;
+	fs->wflag = 0;
+	return FR_OK;
+}
+
+
+#if _FS_BURSTBUF && _FS_FATREADAHEAD
+static
+DRESULT wc_readahead (	/* Read the FAT sector and the following ones. Returns result of disk_read() */
+	FATFS* fs,		/* File system object */
+	DWORD sector,	/* FAT sector number to make appearance in the fs->win[] */
+	UINT n			/* Number of sectors to read (2..burst size) */
+)
+{
+	UINT i, j;
+	WCSLOT *vs;
+
+
+	if (disk_read(fs->drv, fs->bbuf, sector, n) != RES_OK) return RES_ERROR;
+	mem_cpy(fs->win, fs->bbuf, SS(fs));
+	for (i = 1; i < n; i++) {	/* Put the following sectors into the FAT cache */
+		vs = 0;
+		for (j = 0; j < fs->n_fatc; j++) {
+			if (fs->wcache[j].sect == sector + i) break;	/* Already cached (it can be dirty) */
+			if (!(fs->wcache[j].flag & 1) && (!vs || fs->wcache[j].stamp < vs->stamp)) vs = &fs->wcache[j];	/* Least recently used clean slot */
+		}
+		if (j < fs->n_fatc) continue;
+		if (!vs) break;		/* No clean slot to replace */
+		mem_cpy(vs->buf, fs->bbuf + i * SS(fs), SS(fs));
+		vs->sect = sector + i; vs->flag = 0; vs->stamp = ++fs->wcstamp;
+	}
+	return RES_OK;
+}
+#endif
+
+
+static
+FRESULT wc_load (	/* Bring the sector into win[] via the cache. Returns FR_OK or FR_DISK_ERROR */
+	FATFS* fs,		/* File system object */
+	DWORD sector	/* Sector number to make appearance in the fs->win[] */
+)
+{
+	UINT i, n;
+	WCSLOT *pl, *sl;
+	DWORD ws;
+	BYTE wf, d;
+	DRESULT dr;
+
+
+	pl = wc_pool(fs, sector, &n);
+	for (sl = 0, i = 0; i < n && !sl; i++) {	/* Search the pool for the sector */
+		if (pl[i].sect == sector) sl = &pl[i];
+	}
+	if (IS_FATSECT(fs, sector)) {
+		if (sl) fs->fc_hit++; else fs->fc_miss++;
+	} else {
+		if (sl) fs->dc_hit++; else fs->dc_miss++;
+	}
+
+	ws = fs->winsect; wf = fs->wflag;
+	if (sl) {	/* Cache hit */
+		if (ws != 0xFFFFFFFF && IS_FATSECT(fs, ws) == IS_FATSECT(fs, sector)) {	/* Exchange the window and the slot in the same pool */
+			for (i = 0; i < SS(fs); i++) {
+				d = fs->win[i]; fs->win[i] = sl->buf[i]; sl->buf[i] = d;
 			}
+			fs->wflag = sl->flag;
+			sl->sect = ws; sl->flag = wf; sl->stamp = ++fs->wcstamp;
+		} else {	/* Stash the window into the other pool and take the slot out */
+			if (wc_stash(fs) != FR_OK) return FR_DISK_ERR;
+			mem_cpy(fs->win, sl->buf, SS(fs));
+			fs->wflag = sl->flag;
+			sl->sect = 0xFFFFFFFF; sl->flag = 0; sl->stamp = 0;
 		}
+		fs->winsect = sector;
+		return FR_OK;
 	}
-	return res;
+
+	/* Cache miss: stash the window and read the sector */
+	if (wc_stash(fs) != FR_OK) return FR_DISK_ERR;
+	n = 1;
+#if _FS_BURSTBUF && _FS_FATREADAHEAD
+	if (IS_FATSECT(fs, sector)) {
+		if (sector == fs->fc_next && fs->bbuf) {	/* Sequential miss in the FAT area? */
+			n = _FS_FATREADAHEAD + 1;				/* Read ahead following FAT sectors */
+			if (n > fs->n_bbuf) n = fs->n_bbuf;
+			if (n > fs->n_fatc + 1) n = fs->n_fatc + 1;
+			if (n > fs->fatbase + fs->fsize - sector) n = fs->fatbase + fs->fsize - sector;
+		}
+		fs->fc_next = sector + n;
+	}
+	if (n > 1) {
+		dr = wc_readahead(fs, sector, n);
+	} else
+#endif
+	{
+		dr = disk_read(fs->drv, fs->win, sector, 1);
+	}
+	if (dr != RES_OK) {
+		sector = 0xFFFFFFFF;	/* Invalidate window if data is not reliable */
+	}
+	fs->winsect = sector;
+	return dr == RES_OK ? FR_OK : FR_DISK_ERR;
 }
 #endif
 
@@ -904,6 +1203,9 @@ FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERROR */
 
 
 	if (sector != fs->winsect) {	/* Window offset changed? */
+#if _FS_WINCACHE
+		if (fs->n_fatc + fs->n_dirc) return wc_load(fs, sector);	/* Switch the window through the sector cache */
+#endif
 #if !_FS_READONLY
 		res = sync_window(fs);		/* Write-back changes */
 #endif
@@ -921,6 +1223,62 @@ FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERROR */
 
 
 
+#if _FS_LAZYMIRROR
+/*-----------------------------------------------------------------------*/
+/* Reflect deferred changes of the first FAT to the other FAT copies     */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT sync_mirror (	/* FR_OK:succeeded, !=0:error */
+	FATFS* fs			/* File system object */
+)
+{
+	UINT g, ge, nf, n, nbuf;
+	DWORD sect, end;
+	BYTE *buf;
+
+
+	if (fs->n_fats < 2) return FR_OK;
+#if _FS_BURSTBUF
+	if (fs->bbuf) {		/* Copy in bursts through the burst buffer */
+		buf = fs->bbuf; nbuf = fs->n_bbuf;
+	} else
+#endif
+	{					/* Copy sector by sector through the window */
+		if (sync_window(fs) != FR_OK) return FR_DISK_ERR;
+#if _FS_WINCACHE
+		if (wc_stash(fs) != FR_OK) return FR_DISK_ERR;
+#endif
+		fs->winsect = 0xFFFFFFFF;
+		buf = fs->win; nbuf = 1;
+	}
+
+	for (g = 0; g < _FS_LAZYMIRROR * 8; g++) {
+		if (!fs->mdirty[g / 8]) {	/* Skip clean octets */
+			g |= 7; continue;
+		}
+		if (!(fs->mdirty[g / 8] & 1 << (g % 8))) continue;
+		for (ge = g; ge < _FS_LAZYMIRROR * 8 && (fs->mdirty[ge / 8] & 1 << (ge % 8)); ge++) ;	/* Find the end of the dirty run */
+		sect = (DWORD)g << fs->mshift;
+		end = (DWORD)ge << fs->mshift;
+		if (end > fs->fsize) end = fs->fsize;
+		while (sect < end) {	/* Copy the run in ascending order */
+			n = (end - sect < nbuf) ? (UINT)(end - sect) : nbuf;
+			if (disk_read(fs->drv, buf, fs->fatbase + sect, n) != RES_OK) return FR_DISK_ERR;
+			for (nf = 1; nf < fs->n_fats; nf++) {
+				disk_write(fs->drv, buf, fs->fatbase + fs->fsize * nf + sect, n);
+			}
+			sect += n;
+		}
+		for ( ; g < ge; g++) fs->mdirty[g / 8] &= ~(1 << (g % 8));	/* Mark the run clean */
+	}
+	return FR_OK;
+}
+#endif
+
+
+
+
 #if !_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* Synchronize file system and strage device                             */
@@ -934,7 +1292,14 @@ FRESULT sync_fs (	/* FR_OK:succeeded, !=0:error */
 	FRESULT res;
 
 
+#if _FS_WINCACHE
+	res = wc_flush(fs);		/* Write back the window and the sector cache */
+#else
 	res = sync_window(fs);
+#endif
+#if _FS_LAZYMIRROR
+	if (res == FR_OK) res = sync_mirror(fs);	/* Reflect the FAT changes to the FAT copies */
+#endif
 	if (res == FR_OK) {
 		/* Update FSInfo sector if needed */
 		if (fs->fs_type == FS_FAT32 && fs->fsi_flag == 1) {
@@ -947,6 +1312,9 @@ FRESULT sync_fs (	/* FR_OK:succeeded, !=0:error */
 			st_dword(fs->win + FSI_Nxt_Free, fs->last_clst);
 			/* Write it into the FSInfo sector */
 			fs->winsect = fs->volbase + 1;
+#if _FS_WINCACHE
+			wc_purge(fs, fs->winsect, 1);
+#endif
 			disk_write(fs->drv, fs->win, fs->winsect, 1);
 			fs->fsi_flag = 0;
 		}
@@ -1107,6 +1475,15 @@ FRESULT put_fat (	/* FR_OK(0):succeeded, !=0:error */
 			fs->wflag = 1;
 			break;
 		}
+#if _FS_FREEMAP
+		if (res == FR_OK && clst < fs->fm_nclst) {	/* Reflect the change to the free cluster map */
+			if (val & 0x0FFFFFFF) {
+				fs->fmap[clst / 32] |= (DWORD)1 << (clst % 32);
+			} else {
+				fs->fmap[clst / 32] &= ~((DWORD)1 << (clst % 32));
+			}
+		}
+#endif
 	}
 	return res;
 }
@@ -1116,62 +1493,323 @@ FRESULT put_fat (	/* FR_OK(0):succeeded, !=0:error */
 
 
 
-#if _FS_EXFAT && !_FS_READONLY
+#if !_FS_READONLY && (_FS_MINIMIZE == 0 || _FS_FREEMAP)
 /*-----------------------------------------------------------------------*/
-/* exFAT: Accessing FAT and Allocation Bitmap                            */
+/* FAT handling - Count free clusters                                    */
 /*-----------------------------------------------------------------------*/
 
-/*---------------------------------------------*/
-/* exFAT: Find a contiguous free cluster block */
-/*---------------------------------------------*/
+#if _FS_BURSTBUF
+static
+DWORD cnt_free (	/* Number of free entries in a FAT image read with word access */
+	const DWORD* w,	/* Top of the FAT entries (DWORD aligned) */
+	UINT nw,		/* Number of DWORDs to scan */
+	BYTE fmt		/* FAT sub-type (FS_FAT16 or FS_FAT32) */
+)
+{
+	DWORD nfree, v, m;
+
+
+	nfree = 0;
+	if (fmt == FS_FAT16) {	/* FAT16: Two entries per word */
+		for ( ; nw >= 4; w += 4, nw -= 4) {	/* Skip a block of all free entries at once */
+			if ((w[0] | w[1] | w[2] | w[3]) == 0) { nfree += 8; continue; }
+			break;
+		}
+		for ( ; nw; w++, nw--) {
+			v = *w;
+			v = ~(((v & 0x7FFF7FFF) + 0x7FFF7FFF) | v | 0x7FFF7FFF);	/* MSB of each zero half word is set */
+			nfree += ((v >> 15) & 1) + (v >> 31);
+		}
+	} else {				/* FAT32: One entry per word, upper 4 bits are ignored */
+		mem_cpy(&m, "\xFF\xFF\xFF\x0F", 4);	/* Entry mask in the native byte order */
+		for ( ; nw >= 4; w += 4, nw -= 4) {
+			if (((w[0] | w[1] | w[2] | w[3]) & m) == 0) { nfree += 4; continue; }
+			nfree += !(w[0] & m) + !(w[1] & m) + !(w[2] & m) + !(w[3] & m);
+		}
+		for ( ; nw; w++, nw--) nfree += !(*w & m);
+	}
+	return nfree;
+}
+#endif
+
 
 static
-DWORD find_bitmap (	/* 0:No free cluster, 2..:Free cluster found, 0xFFFFFFFF:Disk error */
-	FATFS* fs,	/* File system object */
-	DWORD clst,	/* Cluster number to scan from */
-	DWORD ncl	/* Number of contiguous clusters to find (1..) */
+FRESULT scan_fat (	/* Count free clusters in the range. Returns FR_OK, FR_DISK_ERR or FR_INT_ERR */
+	FATFS* fs,		/* File system object (FAT12/16/32) */
+	DWORD clst,		/* Top of the cluster range */
+	DWORD ecl,		/* End of the cluster range (not included) */
+	BYTE map,		/* Reflect the cluster status to the free cluster map */
+	DWORD* nclst	/* Pointer to return the number of free clusters */
 )
 {
-	BYTE bm, bv;
+	DWORD nfree, stat, sect, epc;
 	UINT i;
-	DWORD val, scl, ctr;
+#if _FS_BURSTBUF
+	UINT n, ns;
+#endif
+	BYTE *p;
+	_FDID obj;
 
 
-	clst -= 2;	/* The first bit in the bitmap corresponds to cluster #2 */
-	if (clst >= fs->n_fatent - 2) clst = 0;
-	scl = val = clst; ctr = 0;
-	for (;;) {
-		if (move_window(fs, fs->database + val / 8 / SS(fs)) != FR_OK) return 0xFFFFFFFF;
-		i = val / 8 % SS(fs); bm = 1 << (val % 8);
-		do {
-			do {
-				bv = fs->win[i] & bm; bm <<= 1;		/* Get bit value */
-				if (++val >= fs->n_fatent - 2) {	/* Next cluster (with wrap-around) */
-					val = 0; bm = 0; i = 4096;
-				}
-				if (!bv) {	/* Is it a free cluster? */
-					if (++ctr == ncl) return scl + 2;	/* Check run length */
-				} else {
-					scl = val; ctr = 0;		/* Encountered a live cluster, restart to scan */
+	nfree = 0;
+	if (fs->fs_type == FS_FAT12) {	/* FAT12: Sector unalighed FAT entries */
+		obj.fs = fs;
+		for ( ; clst < ecl; clst++) {
+			stat = (clst < 2) ? 2 : get_fat(&obj, clst);
+			if (stat == 0xFFFFFFFF) return FR_DISK_ERR;
+			if (stat == 1) return FR_INT_ERR;
+			if (stat == 0) nfree++;
+#if _FS_FREEMAP
+			if (map) {
+				if (stat) fs->fmap[clst / 32] |= (DWORD)1 << (clst % 32); else fs->fmap[clst / 32] &= ~((DWORD)1 << (clst % 32));
+			}
+#endif
+		}
+	} else {						/* FAT16/32: Sector alighed FAT entries */
+		epc = SS(fs) / (fs->fs_type == FS_FAT16 ? 2 : 4);	/* FAT entries per sector */
+		sect = fs->fatbase + clst / epc;
+		i = 0; p = 0;
+#if _FS_BURSTBUF
+		n = ns = 0;
+#endif
+		for ( ; clst < ecl; clst++) {
+			if (i == 0) {	/* Get next FAT sector */
+				i = SS(fs);
+#if _FS_BURSTBUF
+				if (fs->bbuf && fs->n_bbuf > 1) {	/* Read the FAT in multi-sector batches into the burst buffer */
+					if (n == 0) {
+						n = (UINT)((ecl - clst + (clst % epc) + epc - 1) / epc);
+						if (n > fs->n_bbuf) n = fs->n_bbuf;
+						if (disk_read(fs->drv, fs->bbuf, sect, n) != RES_OK) return FR_DISK_ERR;
+						for (ns = 0; ns < n; ns++) {	/* Replace the sectors with their pending changes */
+#if _FS_WINCACHE
+							BYTE *d, *fl;
+
+							d = wc_dirty(fs, sect + ns, &fl);
+							if (d) mem_cpy(fs->bbuf + ns * SS(fs), d, SS(fs));
+#else
+							if (fs->wflag && fs->winsect == sect + ns) mem_cpy(fs->bbuf + ns * SS(fs), fs->win, SS(fs));
+#endif
+						}
+						ns = 0;
+					}
+					p = fs->bbuf + ns * SS(fs);
+					ns++; n--; sect++;
+					if (!map && clst >= 2 && clst % epc == 0 && ecl - clst >= epc) {	/* Count a whole sector with word access */
+						nfree += cnt_free((const DWORD*)p, SS(fs) / 4, fs->fs_type);
+						clst += epc - 1; i = 0;
+						continue;
+					}
+				} else
+#endif
+				{
+					if (move_window(fs, sect++) != FR_OK) return FR_DISK_ERR;
+					p = fs->win;
 				}
-				if (val == clst) return 0;	/* All cluster scanned? */
-			} while (bm);
-			bm = 1;
-		} while (++i < SS(fs));
+				p += (clst % epc) * (SS(fs) / epc);
+				i -= (clst % epc) * (SS(fs) / epc);
+			}
+			if (fs->fs_type == FS_FAT16) {
+				stat = ld_word(p);
+				p += 2; i -= 2;
+			} else {
+				stat = ld_dword(p) & 0x0FFFFFFF;
+				p += 4; i -= 4;
+			}
+			if (clst < 2) stat = 2;		/* Reserved entries */
+			if (stat == 0) nfree++;
+#if _FS_FREEMAP
+			if (map) {
+				if (stat) fs->fmap[clst / 32] |= (DWORD)1 << (clst % 32); else fs->fmap[clst / 32] &= ~((DWORD)1 << (clst % 32));
+			}
+#endif
+		}
 	}
+	*nclst = nfree;
+	return FR_OK;
 }
 
+#endif
 
-/*------------------------------------*/
-/* exFAT: Set/Clear a block of bitmap */
-/*------------------------------------*/
+
+
+
+#if _FS_FREEMAP
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Free cluster map                                       */
+/*-----------------------------------------------------------------------*/
 
 static
-FRESULT change_bitmap (
-	FATFS* fs,	/* File system object */
-	DWORD clst,	/* Cluster number to change from */
-	DWORD ncl,	/* Number of clusters to be changed */
-	int bv		/* bit value to be set (0 or 1) */
+DWORD fm_cover (	/* Returns number of clusters covered by the free cluster map */
+	FATFS* fs,		/* File system object */
+	BYTE fmt		/* FAT sub-type */
+)
+{
+	DWORD n;
+
+
+	if (!fs->fmap || fmt == FS_EXFAT) return 0;
+	n = (DWORD)fs->fm_size * 32;
+	if (n >= fs->n_fatent) return fs->n_fatent;	/* The map covers whole volume */
+	if (fmt != FS_FAT12) n &= ~(DWORD)255;		/* Partial cover ends at a FAT sector boundary */
+	return n;
+}
+
+
+static
+FRESULT fm_build (	/* Build the free cluster map if not built yet */
+	FATFS* fs		/* File system object */
+)
+{
+	FRESULT res;
+	DWORD n;
+
+
+	if (fs->fm_valid || !fs->fm_nclst) return FR_OK;
+	res = scan_fat(fs, 0, fs->fm_nclst, 1, &n);
+	if (res != FR_OK) return res;
+	fs->fm_valid = 1;
+	if (fs->fm_nclst == fs->n_fatent) {		/* The map covers whole volume */
+		fs->free_clst = n;
+		fs->fsi_flag |= 1;
+	}
+	return FR_OK;
+}
+
+
+static
+DWORD fm_count (	/* Number of free clusters in the map */
+	FATFS* fs		/* File system object */
+)
+{
+	DWORD nfree, w, i;
+
+
+	nfree = 0;
+	for (i = 0; i < fs->fm_nclst; i += 32) {
+		w = fs->fmap[i / 32];
+		if (fs->fm_nclst - i < 32) w |= (DWORD)0xFFFFFFFF << (fs->fm_nclst - i);	/* Exclude the bits out of the map */
+		w = ~w;
+		while (w) {		/* Count zero bits */
+			w &= w - 1; nfree++;
+		}
+	}
+	return nfree;
+}
+
+
+static
+DWORD fm_next (		/* Returns the first free cluster in clst..ecl-1 in the map, ecl:Not found */
+	FATFS* fs,		/* File system object */
+	DWORD clst,		/* Cluster to start the search */
+	DWORD ecl		/* End of the search range (<= fm_nclst) */
+)
+{
+	DWORD w;
+
+
+	while (clst < ecl) {
+		w = fs->fmap[clst / 32] | (((DWORD)1 << (clst % 32)) - 1);	/* Mask out the clusters before clst */
+		if (w != 0xFFFFFFFF) {		/* Any free cluster in this word? */
+			for (clst &= ~(DWORD)31; w & 1; w >>= 1) clst++;
+			return (clst < ecl) ? clst : ecl;
+		}
+		clst = (clst | 31) + 1;		/* Next word */
+	}
+	return ecl;
+}
+
+
+static
+DWORD fm_search (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk error, >=2:Free cluster# */
+	_FDID* obj,		/* Corresponding object */
+	DWORD scl		/* The search starts at the next cluster of this */
+)
+{
+	FATFS *fs = obj->fs;
+	DWORD ncl, n, e, cs;
+
+
+	ncl = scl + 1;
+	for (n = fs->n_fatent - 2; n; ) {	/* Check every cluster once */
+		if (ncl >= fs->n_fatent) ncl = 2;		/* Wrap-around */
+		if (ncl < fs->fm_nclst) {				/* Search the map */
+			e = fs->fm_nclst;
+			if (e - ncl > n) e = ncl + n;
+			cs = fm_next(fs, ncl, e);
+			if (cs < e) return cs;
+			n -= e - ncl; ncl = e;
+		} else {								/* Out of the map, search the FAT */
+			cs = get_fat(obj, ncl);
+			if (cs == 0) return ncl;
+			if (cs == 1 || cs == 0xFFFFFFFF) return cs;
+			n--; ncl++;
+		}
+	}
+	return 0;
+}
+
+#endif /* _FS_FREEMAP */
+
+
+
+
+#if _FS_EXFAT && !_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* exFAT: Accessing FAT and Allocation Bitmap                            */
+/*-----------------------------------------------------------------------*/
+
+/*---------------------------------------------*/
+/* exFAT: Find a contiguous free cluster block */
+/*---------------------------------------------*/
+
+static
+DWORD find_bitmap (	/* 0:No free cluster, 2..:Free cluster found, 0xFFFFFFFF:Disk error */
+	FATFS* fs,	/* File system object */
+	DWORD clst,	/* Cluster number to scan from */
+	DWORD ncl	/* Number of contiguous clusters to find (1..) */
+)
+{
+	BYTE bm, bv;
+	UINT i;
+	DWORD val, scl, ctr;
+
+
+	clst -= 2;	/* The first bit in the bitmap corresponds to cluster #2 */
+	if (clst >= fs->n_fatent - 2) clst = 0;
+	scl = val = clst; ctr = 0;
+	for (;;) {
+		if (move_window(fs, fs->database + val / 8 / SS(fs)) != FR_OK) return 0xFFFFFFFF;
+		i = val / 8 % SS(fs); bm = 1 << (val % 8);
+		do {
+			do {
+				bv = fs->win[i] & bm; bm <<= 1;		/* Get bit value */
+				if (++val >= fs->n_fatent - 2) {	/* Next cluster (with wrap-around) */
+					val = 0; bm = 0; i = 4096;
+				}
+				if (!bv) {	/* Is it a free cluster? */
+					if (++ctr == ncl) return scl + 2;	/* Check run length */
+				} else {
+					scl = val; ctr = 0;		/* Encountered a live cluster, restart to scan */
+				}
+				if (val == clst) return 0;	/* All cluster scanned? */
+			} while (bm);
+			bm = 1;
+		} while (++i < SS(fs));
+	}
+}
+
+
+/*------------------------------------*/
+/* exFAT: Set/Clear a block of bitmap */
+/*------------------------------------*/
+
+static
+FRESULT change_bitmap (
+	FATFS* fs,	/* File system object */
+	DWORD clst,	/* Cluster number to change from */
+	DWORD ncl,	/* Number of clusters to be changed */
+	int bv		/* bit value to be set (0 or 1) */
 )
 {
 	BYTE bm;
@@ -1224,6 +1862,60 @@ FRESULT fill_fat_chain (
 
 
 
+#if _FS_TAILCACHE
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Tail cluster cache                                     */
+/*-----------------------------------------------------------------------*/
+
+static
+void tc_store (
+	FATFS* fs,		/* File system object */
+	DWORD scl,		/* Top cluster of the chain */
+	DWORD idx,		/* Index of the cluster in the chain */
+	DWORD clst		/* Cluster to be cached */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < _FS_TAILCACHE && fs->tc_scl[i] != scl; i++) ;	/* Find the entry of the chain */
+	if (i == _FS_TAILCACHE) {		/* Not cached, replace the oldest entry */
+		i = fs->tc_next;
+		fs->tc_next = (BYTE)((i + 1) % _FS_TAILCACHE);
+		fs->tc_scl[i] = scl;
+	}
+	fs->tc_idx[i] = idx;
+	fs->tc_clst[i] = clst;
+}
+
+
+static
+DWORD tc_find (		/* Returns number of clusters to skip (0:not cached) */
+	FATFS* fs,		/* File system object */
+	DWORD scl,		/* Top cluster of the chain */
+	FSIZE_t ofs,	/* Offset to follow the chain to (>0) */
+	DWORD* clst		/* Returns the cluster to start from */
+)
+{
+	UINT i;
+	DWORD idx;
+
+
+	for (i = 0; i < _FS_TAILCACHE; i++) {
+		idx = fs->tc_idx[i];
+		if (scl && fs->tc_scl[i] == scl && (ofs - 1) / ((DWORD)fs->csize * SS(fs)) >= idx) {	/* On the way to the offset? */
+			*clst = fs->tc_clst[i];
+			return idx;
+		}
+	}
+	return 0;
+}
+
+#endif
+
+
+
+
 #if !_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* FAT handling - Remove a cluster chain                                 */
@@ -1246,6 +1938,42 @@ FRESULT remove_chain (	/* FR_OK(0):succeeded, !=0:error */
 #endif
 
 	if (clst < 2 || clst >= fs->n_fatent) return FR_INT_ERR;	/* Check if in valid range */
+#if _FS_TAILCACHE
+	mem_set(fs->tc_scl, 0, sizeof fs->tc_scl);	/* Cached clusters can be freed or reused */
+#endif
+#if _FS_DIRINDEX
+	if (pclst == 0) {				/* Discard the index of the directory to be removed */
+		for (nxt = 0; nxt < _FS_DIRINDEX; nxt++) {
+			if (fs->ix_scl[nxt] == clst) fs->ix_stat[nxt] = fs->ix_use[nxt] = 0;
+		}
+	}
+#endif
+#if _FS_DIRHINT
+	if (pclst == 0) {				/* Discard the blank entry hint of the directory to be removed */
+		for (nxt = 0; nxt < _FS_DIRHINT; nxt++) {
+			if (fs->bh_scl[nxt] == clst) fs->bh_ofs[nxt] = 0;
+		}
+	}
+#endif
+#if _FS_PREALLOC
+	if (pclst == 0) {				/* Discard the window of the chain to be removed */
+		for (nxt = 0; nxt < _FS_PREALLOC_FILES; nxt++) {
+			if (fs->pa_ocl[nxt] == clst) fs->pa_use[nxt] = 0;
+		}
+	}
+#endif
+#if _FS_LINKMAP
+	for (nxt = 0; nxt < _FS_LINKMAP; nxt++) {	/* Discard the map of the chain to be cut or removed */
+		if (fs->lmscl[nxt] == (pclst ? obj->sclust : clst)) fs->lmscl[nxt] = 0;
+	}
+#endif
+#if _FS_PATHCACHE
+	if (pclst == 0) {				/* Discard the cached objects in the directory to be removed */
+		for (nxt = 0; nxt < _FS_PATHCACHE; nxt++) {
+			if (fs->pcache[nxt].pscl == clst || fs->pcache[nxt].scl == clst) fs->pcache[nxt].stamp = 0;
+		}
+	}
+#endif
 
 	/* Mark the previous cluster 'EOC' on the FAT if it exists */
 	if (pclst && (!_FS_EXFAT || fs->fs_type != FS_EXFAT || obj->stat != 2)) {
@@ -1267,6 +1995,9 @@ FRESULT remove_chain (	/* FR_OK(0):succeeded, !=0:error */
 			fs->free_clst++;
 			fs->fsi_flag |= 1;
 		}
+#if _FS_GETFREE_NB
+		if (clst < fs->gf_clst) fs->gf_nfree++;	/* Freed in the area already counted */
+#endif
 #if _FS_EXFAT || _USE_TRIM
 		if (ecl + 1 == nxt) {	/* Is next cluster contiguous? */
 			ecl = nxt;
@@ -1305,6 +2036,96 @@ FRESULT remove_chain (	/* FR_OK(0):succeeded, !=0:error */
 
 
 
+#if _FS_PREALLOC
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Per-file preallocation window                          */
+/*-----------------------------------------------------------------------*/
+
+static
+int pa_find (		/* Returns slot index of the object, -1:not found */
+	FATFS* fs,		/* File system object */
+	const _FDID* obj	/* Object to find */
+)
+{
+	int i;
+
+
+	if (!obj->sclust) return -1;		/* An object without chain has no window */
+	for (i = 0; i < _FS_PREALLOC_FILES; i++) {
+		if (fs->pa_use[i] && fs->pa_id[i] == obj->id && fs->pa_ocl[i] == obj->sclust) return i;
+	}
+	return -1;
+}
+
+
+static
+void pa_open (		/* Assign a preallocation window slot to the file if available */
+	FATFS* fs,		/* File system object */
+	const _FDID* obj,	/* Object of the file being stretched */
+	DWORD clst		/* Last cluster of the chain (the window follows it) */
+)
+{
+	int i, lru = 0;
+
+
+	if (!obj->sclust) return;			/* The window is assigned when the chain is created */
+	i = pa_find(fs, obj);
+	if (i >= 0) {						/* Already has a slot */
+		fs->pa_use[i] = fs->pa_stamp;
+		return;
+	}
+	for (i = 0; i < _FS_PREALLOC_FILES && fs->pa_use[i] && fs->pa_id[i] == fs->id; i++) {
+		if (fs->pa_use[i] < fs->pa_use[lru]) lru = i;
+	}
+	if (i == _FS_PREALLOC_FILES) {		/* No free slot */
+		if (fs->pa_stamp - fs->pa_use[lru] < _FS_PREALLOC * _FS_PREALLOC_FILES) return;	/* The file grows without window while the owners are active */
+		i = lru;						/* Expire the window whose owner has not stretched its chain for a long time */
+	}
+	fs->pa_id[i] = obj->id;
+	fs->pa_ocl[i] = obj->sclust;
+	fs->pa_use[i] = fs->pa_stamp;
+	fs->pa_scl[i] = clst + 1;
+	fs->pa_ecl[i] = (clst + 1 + _FS_PREALLOC < fs->n_fatent) ? clst + 1 + _FS_PREALLOC : fs->n_fatent;
+}
+
+
+static
+void pa_release (	/* Release the preallocation window of the object */
+	FATFS* fs,		/* File system object */
+	const _FDID* obj	/* Object of the file */
+)
+{
+	int i;
+
+
+	i = pa_find(fs, obj);
+	if (i >= 0) fs->pa_use[i] = 0;
+}
+
+
+static
+DWORD pa_check (	/* Returns end of the window the cluster is reserved in for another object, 0:Not reserved */
+	FATFS* fs,		/* File system object */
+	const _FDID* obj,	/* Object which allocates the cluster */
+	DWORD clst		/* Cluster to be allocated */
+)
+{
+	int i;
+
+
+	for (i = 0; i < _FS_PREALLOC_FILES; i++) {
+		if (!fs->pa_use[i] || fs->pa_id[i] != fs->id) continue;	/* Free slot or window of a former mount */
+		if (obj->sclust && fs->pa_id[i] == obj->id && fs->pa_ocl[i] == obj->sclust) continue;	/* Window of the object itself */
+		if (clst - fs->pa_scl[i] < fs->pa_ecl[i] - fs->pa_scl[i]) return fs->pa_ecl[i];
+	}
+	return 0;
+}
+
+#endif /* _FS_PREALLOC */
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* FAT handling - Stretch a chain or Create a new chain                  */
 /*-----------------------------------------------------------------------*/
@@ -1317,6 +2138,10 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 	DWORD cs, ncl, scl;
 	FRESULT res;
 	FATFS *fs = obj->fs;
+#if _FS_PREALLOC
+	UINT nskip;
+	int i;
+#endif
 
 
 	if (clst == 0) {	/* Create a new chain */
@@ -1347,6 +2172,18 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 			}
 		}
 	} else
+#endif
+#if _FS_PREALLOC
+	for (nskip = 0; ; nskip++)	/* Find a free cluster not reserved for other files */
+#endif
+	{
+#if _FS_FREEMAP
+	if (fs->fm_nclst) {	/* At the FAT12/16/32 with free cluster map */
+		res = fm_build(fs);
+		if (res != FR_OK) return (res == FR_DISK_ERR) ? 0xFFFFFFFF : 1;
+		ncl = fm_search(obj, scl);		/* Find a free cluster */
+		if (ncl < 2 || ncl == 0xFFFFFFFF) return ncl;
+	} else
 #endif
 	{	/* At the FAT12/16/32 */
 		ncl = scl;	/* Start cluster */
@@ -1362,6 +2199,15 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 			if (ncl == scl) return 0;		/* No free cluster */
 		}
 	}
+#if _FS_PREALLOC
+		if (nskip >= _FS_PREALLOC_FILES) break;		/* Take a reserved cluster rather than failing on a nearly full volume */
+		cs = pa_check(fs, obj, ncl);
+		if (!cs) break;								/* Not reserved for others */
+		scl = (cs < fs->n_fatent) ? cs - 1 : 1;		/* Skip the window and search again */
+	}
+#else
+	}
+#endif
 
 	if (_FS_EXFAT && fs->fs_type == FS_EXFAT && obj->stat == 2) {	/* Is it a contiguous chain? */
 		res = FR_OK;						/* FAT does not need to be written */
@@ -1376,6 +2222,18 @@ DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:Disk err
 		fs->last_clst = ncl;
 		if (fs->free_clst < fs->n_fatent - 2) fs->free_clst--;
 		fs->fsi_flag |= 1;
+#if _FS_GETFREE_NB
+		if (ncl < fs->gf_clst) fs->gf_nfree--;	/* Allocated in the area already counted */
+#endif
+#if _FS_PREALLOC
+		i = pa_find(fs, obj);
+		fs->pa_stamp++;
+		if (i >= 0) {			/* Slide the window of the file to the clusters following the new one */
+			fs->pa_use[i] = fs->pa_stamp;
+			fs->pa_scl[i] = ncl + 1;
+			fs->pa_ecl[i] = (ncl + 1 + _FS_PREALLOC < fs->n_fatent) ? ncl + 1 + _FS_PREALLOC : fs->n_fatent;
+		}
+#endif
 	} else {
 		ncl = (res == FR_DISK_ERR) ? 0xFFFFFFFF : 1;	/* Failed. Create error status */
 	}
@@ -1414,6 +2272,133 @@ DWORD clmt_clust (	/* <2:Error, >=2:Cluster number */
 	return cl + *tbl;	/* Return the cluster number */
 }
 
+
+#if _FS_LINKMAP
+static
+void lm_check (	/* Check if the library-managed CLMT of the file is still valid */
+	FIL* fp		/* Pointer to the file object */
+)
+{
+	FATFS *fs = fp->obj.fs;
+	UINT i;
+
+
+	if (fp->lmap != 1) return;
+	for (i = 0; i < _FS_LINKMAP; i++) {
+		if (fp->cltbl == fs->lmtbl[i]) {
+			if (fs->lmscl[i] == fp->obj.sclust) {	/* The slot still maps the chain of the file */
+				fs->lmref[i] = 1;
+			} else {								/* The slot has been released or reused */
+				fp->cltbl = 0; fp->lmap = 0;		/* Map the chain again on demand */
+			}
+			return;
+		}
+	}
+	fp->lmap = fp->cltbl ? 2 : 0;	/* Application took over the fast seek mode */
+}
+
+
+static
+void lm_release (	/* Release the library-managed CLMT of the file */
+	FIL* fp,		/* Pointer to the file object */
+	BYTE stat		/* New status of the map (0:to be built again, 2:not applicable) */
+)
+{
+	FATFS *fs = fp->obj.fs;
+	UINT i;
+
+
+	for (i = 0; i < _FS_LINKMAP; i++) {
+		if (fp->cltbl == fs->lmtbl[i]) {	/* A CLMT supplied by the application is left as is */
+			if (fs->lmscl[i] == fp->obj.sclust) fs->lmscl[i] = 0;	/* Free the slot unless it has been reused */
+			fp->cltbl = 0;
+		}
+	}
+	fp->lmap = stat;
+}
+
+
+static
+FRESULT lm_build (	/* Build the library-managed CLMT of the file if a slot is available */
+	FIL* fp,		/* Pointer to the file object */
+	DWORD tix,		/* Index of the cluster to be reached in the chain */
+	DWORD* hix,		/* Index of a cluster on the way to tix when the chain cannot be mapped */
+	DWORD* hcl		/* Cluster# at hix (not changed when nothing is found on the way) */
+)
+{
+	FATFS *fs = fp->obj.fs;
+	DWORD cl, pcl, ncl, tcl, ulen, nc, *tbl;
+	UINT i;
+
+
+	for (i = 0; i < _FS_LINKMAP && fs->lmscl[i] != fp->obj.sclust; i++) ;
+	if (i < _FS_LINKMAP) {			/* The chain is mapped for another file object */
+		fs->lmref[i] = 1;
+		fp->cltbl = fs->lmtbl[i];
+		fp->lmap = 1;
+		return FR_OK;
+	}
+	for (i = 0; i < _FS_LINKMAP && fs->lmscl[i] && fs->lmref[i]; i++) {
+		fs->lmref[i] = 0;			/* A map not referenced until the next search is reused */
+	}
+	if (i == _FS_LINKMAP) return FR_OK;	/* No slot to be used (normal seek is used) */
+	fs->lmscl[i] = 0;				/* Users of the former map will map their chain again */
+
+	tbl = fs->lmtbl[i] + 1; ulen = 2; nc = 0;
+	cl = fp->obj.sclust;			/* Origin of the chain */
+	do {
+		if (ulen + 2 > _FS_LINKMAP_SIZE) {	/* Too fragmented to be mapped in the slot */
+			if (tix >= nc) {		/* Normal seek can continue from the top of the fragment */
+				*hix = nc; *hcl = cl;
+			}
+			fp->lmap = 2;
+			return FR_OK;
+		}
+		tcl = cl; ncl = 0; ulen += 2;	/* Top, length and used items */
+		do {
+			pcl = cl; ncl++;
+			cl = get_fat(&fp->obj, cl);
+			if (cl <= 1) return FR_INT_ERR;
+			if (cl == 0xFFFFFFFF) return FR_DISK_ERR;
+		} while (cl == pcl + 1);
+		*tbl++ = ncl; *tbl++ = tcl;		/* Store the length and top of the fragment */
+		if (tix >= nc && tix < nc + ncl) {	/* The fragment holds the cluster to be reached */
+			*hix = tix; *hcl = tcl + (tix - nc);
+		}
+		nc += ncl;
+	} while (cl < fs->n_fatent);	/* Repeat until end of chain */
+	*tbl = 0;						/* Terminate table */
+	fs->lmtbl[i][0] = ulen;
+	fs->lmscl[i] = fp->obj.sclust;
+	fs->lmref[i] = 1;
+	fp->cltbl = fs->lmtbl[i];
+	fp->lmap = 1;
+	return FR_OK;
+}
+
+
+#if !_FS_READONLY
+static
+void lm_append (	/* Append a new cluster of the chain to the library-managed CLMT */
+	FIL* fp,		/* Pointer to the file object */
+	DWORD clst		/* Cluster added at end of the chain */
+)
+{
+	DWORD *tbl = fp->cltbl, ulen = tbl[0];
+
+
+	if (tbl[ulen - 2] + tbl[ulen - 3] == clst) {	/* Contiguous to the last fragment */
+		tbl[ulen - 3]++;
+	} else if (ulen + 2 <= _FS_LINKMAP_SIZE) {		/* Add a fragment */
+		tbl[ulen - 1] = 1; tbl[ulen] = clst; tbl[ulen + 1] = 0;
+		tbl[0] = ulen + 2;
+	} else {										/* Too fragmented to be mapped */
+		lm_release(fp, 2);
+	}
+}
+#endif
+#endif	/* _FS_LINKMAP */
+
 #endif	/* _USE_FASTSEEK */
 
 
@@ -1512,6 +2497,9 @@ FRESULT dir_next (	/* FR_OK(0):succeeded, FR_NO_FILE:End of table, FR_DENIED:Cou
 					/* Clean-up the stretched table */
 					if (_FS_EXFAT) dp->obj.stat |= 4;			/* The directory needs to be updated */
 					if (sync_window(fs) != FR_OK) return FR_DISK_ERR;	/* Flush disk access window */
+#if _FS_WINCACHE
+					wc_purge(fs, clust2sect(fs, clst), fs->csize);	/* Discard stale copies of the new cluster */
+#endif
 					mem_set(fs->win, 0, SS(fs));				/* Clear window buffer */
 					for (n = 0, fs->winsect = clust2sect(fs, clst); n < fs->csize; n++, fs->winsect++) {	/* Fill the new cluster with 0 */
 						fs->wflag = 1;
@@ -1537,6 +2525,140 @@ FRESULT dir_next (	/* FR_OK(0):succeeded, FR_NO_FILE:End of table, FR_DENIED:Cou
 
 
 
+#if _FS_DIRINDEX
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Name index                                       */
+/*-----------------------------------------------------------------------*/
+
+static
+BYTE ix_hash (		/* Returns hash value of the SFN (1..255) */
+	const BYTE* fn	/* Pointer to the SFN {body[8],ext[3]} */
+)
+{
+	BYTE h = 0;
+	UINT n = 11;
+
+
+	do h = (BYTE)(h * 37 + *fn++); while (--n);
+	return h ? h : 1;
+}
+
+
+static
+int ix_slot (		/* Returns index slot of the directory, -1:not indexed */
+	DIR* dp,		/* Pointer to the directory object */
+	int create		/* 1:Assign the least recently used slot if not indexed */
+)
+{
+	FATFS *fs = dp->obj.fs;
+	int i, lru = 0;
+
+
+	if (!fs->ixbuf) return -1;
+	for (i = 0; i < _FS_DIRINDEX; i++) {
+		if ((fs->ix_stat[i] & 1) && fs->ix_scl[i] == dp->obj.sclust) break;	/* Is the directory indexed? */
+		if (fs->ix_use[i] < fs->ix_use[lru]) lru = i;
+	}
+	if (i == _FS_DIRINDEX) {
+		if (!create) return -1;
+		i = lru;							/* Start a new index in the slot */
+		fs->ix_scl[i] = dp->obj.sclust;
+		fs->ix_cnt[i] = 0;
+		fs->ix_stat[i] = 1;
+	}
+	fs->ix_use[i] = ++fs->ix_stamp;
+	return i;
+}
+
+
+#if !_FS_READONLY
+static
+void ix_update (	/* Reflect a change of the entry at the current offset to the index */
+	DIR* dp,		/* Pointer to the directory object */
+	BYTE h			/* Hash value of the new entry (0:entry removed) */
+)
+{
+	FATFS *fs = dp->obj.fs;
+	int i;
+	UINT n;
+	BYTE *tbl;
+
+
+	i = ix_slot(dp, 0);
+	if (i < 0) return;
+	tbl = fs->ixbuf + i * fs->ix_size;
+	n = dp->dptr / SZDIRE;
+	if (n >= fs->ix_cnt[i]) {			/* Out of the indexed entries? */
+		if (!h || !(fs->ix_stat[i] & 2)) return;	/* It will be indexed when scanned */
+		while (fs->ix_cnt[i] < n && fs->ix_cnt[i] < fs->ix_size) tbl[fs->ix_cnt[i]++] = 0;	/* Entries in between are blank */
+		if (n >= fs->ix_size) {			/* The entry is out of the index area */
+			fs->ix_stat[i] &= ~2; return;
+		}
+		fs->ix_cnt[i]++;
+	}
+	tbl[n] = h;
+}
+
+#endif
+
+#endif	/* _FS_DIRINDEX */
+
+
+
+
+#if _FS_DIRHINT && !_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Blank entry hint                                 */
+/*-----------------------------------------------------------------------*/
+
+static
+UINT* bh_get (		/* Returns the blank entry hint of the directory, NULL:no hint */
+	DIR* dp,		/* Pointer to the directory object */
+	int create		/* 1:Assign a free slot or the next slot in turn if no hint */
+)
+{
+	FATFS *fs = dp->obj.fs;
+	UINT i, fr = _FS_DIRHINT;
+
+
+	for (i = 0; i < _FS_DIRHINT; i++) {
+		if (fs->bh_ofs[i] && fs->bh_scl[i] == dp->obj.sclust) return &fs->bh_ofs[i];	/* Is there a hint of the directory? */
+		if (!fs->bh_ofs[i] && fr == _FS_DIRHINT) fr = i;
+	}
+	if (!create) return 0;
+	if (fr == _FS_DIRHINT) {			/* Replace the slots in turn when all are in use */
+		fr = fs->bh_next;
+		fs->bh_next = (BYTE)((fr + 1) % _FS_DIRHINT);
+	}
+	fs->bh_scl[fr] = dp->obj.sclust;
+	return &fs->bh_ofs[fr];
+}
+
+
+static
+void bh_update (	/* Reflect a change of the entry at the current offset to the hint */
+	DIR* dp,		/* Pointer to the directory object */
+	int used		/* 1:Entry filled, 0:Entry removed */
+)
+{
+	UINT *bh, n;
+
+
+	bh = bh_get(dp, 0);
+	if (!bh) return;
+	n = dp->dptr / SZDIRE;
+	if (used) {
+		if (n == *bh) (*bh)++;			/* Move the hint over the filled entry */
+	} else {
+		if (n < *bh) *bh = n;			/* Move the hint back to the removed entry (0 frees the slot) */
+	}
+}
+
+#endif	/* _FS_DIRHINT && !_FS_READONLY */
+
+
+
+
 #if !_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* Directory handling - Reserve a block of directory entries             */
@@ -1551,9 +2673,17 @@ FRESULT dir_alloc (	/* FR_OK(0):succeeded, !=0:error */
 	FRESULT res;
 	UINT n;
 	FATFS *fs = dp->obj.fs;
+#if _FS_DIRHINT
+	UINT *bh;
+#endif
 
 
+#if _FS_DIRHINT
+	bh = bh_get(dp, 0);
+	res = dir_sdi(dp, bh ? (*bh - 1) * SZDIRE : 0);	/* Skip the entries known to be in use (from the last one, which may be at end of the table) */
+#else
 	res = dir_sdi(dp, 0);
+#endif
 	if (res == FR_OK) {
 		n = 0;
 		do {
@@ -1571,6 +2701,12 @@ FRESULT dir_alloc (	/* FR_OK(0):succeeded, !=0:error */
 			res = dir_next(dp, 1);
 		} while (res == FR_OK);	/* Next entry with table stretch enabled */
 	}
+#if _FS_DIRHINT
+	if (res == FR_OK && dp->dptr) {	/* Entries in front of the found one are in use */
+		bh = bh_get(dp, 1);
+		*bh = dp->dptr / SZDIRE;
+	}
+#endif
 
 	if (res == FR_NO_FILE) res = FR_DENIED;	/* No directory entry to allocate */
 	return res;
@@ -2169,10 +3305,15 @@ FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 {
 	FRESULT res;
 	FATFS *fs = dp->obj.fs;
-	BYTE c;
+	BYTE c = 0;
 #if _USE_LFN != 0
 	BYTE a, ord, sum;
 #endif
+#if _FS_DIRINDEX
+	int ix;
+	UINT n;
+	BYTE h, *tbl = 0;
+#endif
 
 	res = dir_sdi(dp, 0);			/* Rewind directory object */
 	if (res != FR_OK) return res;
@@ -2196,12 +3337,35 @@ FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 	/* At the FAT12/16/32 */
 #if _USE_LFN != 0
 	ord = sum = 0xFF; dp->blk_ofs = 0xFFFFFFFF;	/* Reset LFN sequence */
+#endif
+#if _FS_DIRINDEX
+	ix = ix_slot(dp, 1);			/* Get name index of the directory */
+	if (ix >= 0) {
+		h = ix_hash(dp->fn);
+		tbl = fs->ixbuf + ix * fs->ix_size;
+		for (n = 0; n < fs->ix_cnt[ix]; n++) {	/* Check only the indexed entries with matched hash */
+			if (tbl[n] != h) continue;
+			res = dir_sdi(dp, n * SZDIRE);
+			if (res == FR_OK) res = move_window(fs, dp->sect);
+			if (res != FR_OK) return res;
+			dp->obj.attr = dp->dir[DIR_Attr] & AM_MASK;
+			if (!(dp->dir[DIR_Attr] & AM_VOL) && !mem_cmp(dp->dir, dp->fn, 11)) return FR_OK;	/* Is it a valid entry? */
+		}
+		if (fs->ix_stat[ix] & 2) return FR_NO_FILE;	/* No object out of the index */
+		res = dir_sdi(dp, n * SZDIRE);	/* Search the rest of the directory */
+		if (res != FR_OK) return res;
+	}
 #endif
 	do {
 		res = move_window(fs, dp->sect);
 		if (res != FR_OK) break;
 		c = dp->dir[DIR_Name];
 		if (c == 0) { res = FR_NO_FILE; break; }	/* Reached to end of table */
+#if _FS_DIRINDEX
+		if (ix >= 0 && dp->dptr / SZDIRE == fs->ix_cnt[ix] && fs->ix_cnt[ix] < fs->ix_size) {	/* Add the entry to the index */
+			tbl[fs->ix_cnt[ix]++] = (c == DDEM || (dp->dir[DIR_Attr] & AM_VOL)) ? 0 : ix_hash(dp->dir);
+		}
+#endif
 #if _USE_LFN != 0	/* LFN configuration */
 		dp->obj.attr = a = dp->dir[DIR_Attr] & AM_MASK;
 		if (c == DDEM || ((a & AM_VOL) && a != AM_LFN)) {	/* An entry without valid data */
@@ -2223,17 +3387,129 @@ FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 				ord = 0xFF; dp->blk_ofs = 0xFFFFFFFF;	/* Reset LFN sequence */
 			}
 		}
-#else		/* Non LFN configuration */
-		dp->obj.attr = dp->dir[DIR_Attr] & AM_MASK;
-		if (!(dp->dir[DIR_Attr] & AM_VOL) && !mem_cmp(dp->dir, dp->fn, 11)) break;	/* Is it a valid entry? */
-#endif
-		res = dir_next(dp, 0);	/* Next entry */
-	} while (res == FR_OK);
+#else		/* Non LFN configuration */
+		dp->obj.attr = dp->dir[DIR_Attr] & AM_MASK;
+		if (!(dp->dir[DIR_Attr] & AM_VOL) && !mem_cmp(dp->dir, dp->fn, 11)) break;	/* Is it a valid entry? */
+#endif
+		res = dir_next(dp, 0);	/* Next entry */
+	} while (res == FR_OK);
+#if _FS_DIRINDEX
+	if (res == FR_NO_FILE && ix >= 0 && fs->ix_cnt[ix] == dp->dptr / SZDIRE + (c != 0)) {	/* Have all entries been indexed? */
+		fs->ix_stat[ix] |= 2;
+	}
+#endif
+
+	return res;
+}
+
+
+
+
+#if _FS_PATHCACHE
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Path resolution cache                            */
+/*-----------------------------------------------------------------------*/
+
+static
+PCSLOT* pc_get (	/* Returns the cache item of the segment name, NULL:not cached */
+	DIR* dp			/* Pointer to the directory object with the segment name */
+)
+{
+	FATFS *fs = dp->obj.fs;
+	PCSLOT *pc;
+	UINT i;
+
+
+	for (i = 0, pc = fs->pcache; i < _FS_PATHCACHE; i++, pc++) {
+		if (pc->stamp && pc->pscl == dp->obj.sclust && !mem_cmp(pc->fn, dp->fn, 11)) {
+			pc->stamp = ++fs->pcstamp;
+			return pc;
+		}
+	}
+	return 0;
+}
+
+
+static
+int pc_enter (		/* 1:Moved into the sub-directory, 0:Not cached */
+	DIR* dp			/* Pointer to the directory object with the segment name */
+)
+{
+	PCSLOT *pc;
+
+
+	pc = pc_get(dp);
+	if (!pc || pc->ofs == 0xFFFFFFFF || !(pc->attr & AM_DIR)) return 0;
+	dp->obj.attr = pc->attr;
+	dp->obj.sclust = pc->scl;	/* Open the sub-directory */
+	return 1;
+}
+
+
+static
+FRESULT pc_find (	/* FR_OK(0):succeeded, !=0:error */
+	DIR* dp			/* Pointer to the directory object with the segment name */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	PCSLOT *pc;
+	UINT i;
+
+
+	if (dp->fn[NSFLAG] & NS_DOT) return dir_find(dp);	/* Dot entries are not cached */
+	pc = pc_get(dp);
+	if (pc) {
+		if (pc->ofs == 0xFFFFFFFF) return FR_NO_FILE;	/* Known as not exist */
+		res = dir_sdi(dp, pc->ofs);		/* Go to the cached location */
+		if (res == FR_OK) res = move_window(fs, dp->sect);
+		if (res != FR_OK) return res;
+		if (!(dp->dir[DIR_Attr] & AM_VOL) && !mem_cmp(dp->dir, dp->fn, 11)) {	/* Is the object still there? */
+			dp->obj.attr = dp->dir[DIR_Attr] & AM_MASK;
+			return FR_OK;
+		}
+		pc->stamp = 0;					/* Discard the stale item */
+	}
 
+	res = dir_find(dp);
+	if (res == FR_OK || res == FR_NO_FILE) {	/* Cache the result in the least recently used item */
+		for (i = 1, pc = fs->pcache; i < _FS_PATHCACHE; i++) {
+			if (fs->pcache[i].stamp < pc->stamp) pc = &fs->pcache[i];
+		}
+		pc->pscl = dp->obj.sclust;
+		mem_cpy(pc->fn, dp->fn, 11);
+		pc->ofs = 0xFFFFFFFF;
+		if (res == FR_OK) {
+			pc->ofs = dp->dptr;
+			pc->scl = ld_clust(fs, dp->dir);
+			pc->attr = dp->obj.attr;
+		}
+		pc->stamp = ++fs->pcstamp;
+	}
 	return res;
 }
 
 
+#if !_FS_READONLY
+static
+void pc_drop (		/* Discard the cache items of the entry */
+	DIR* dp			/* Pointer to the directory object pointing the entry in the win[] */
+)
+{
+	FATFS *fs = dp->obj.fs;
+	PCSLOT *pc;
+	UINT i;
+
+
+	for (i = 0, pc = fs->pcache; i < _FS_PATHCACHE; i++, pc++) {
+		if (pc->pscl == dp->obj.sclust && !mem_cmp(pc->fn, dp->dir, 11)) pc->stamp = 0;
+	}
+}
+#endif
+
+#endif	/* _FS_PATHCACHE */
+
+
 
 
 #if !_FS_READONLY
@@ -2329,6 +3605,15 @@ FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too many S
 			dp->dir[DIR_NTres] = dp->fn[NSFLAG] & (NS_BODY | NS_EXT);	/* Put NT flag */
 #endif
 			fs->wflag = 1;
+#if _FS_DIRINDEX
+			ix_update(dp, ix_hash(dp->fn));	/* Add the name to the index */
+#endif
+#if _FS_DIRHINT
+			bh_update(dp, 1);				/* The entry is no longer blank */
+#endif
+#if _FS_PATHCACHE
+			pc_drop(dp);					/* The name is no longer missing */
+#endif
 		}
 	}
 
@@ -2375,8 +3660,17 @@ FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 
 	res = move_window(fs, dp->sect);
 	if (res == FR_OK) {
+#if _FS_PATHCACHE
+		pc_drop(dp);	/* Forget the object */
+#endif
 		dp->dir[DIR_Name] = DDEM;
 		fs->wflag = 1;
+#if _FS_DIRINDEX
+		ix_update(dp, 0);	/* Remove the name from the index */
+#endif
+#if _FS_DIRHINT
+		bh_update(dp, 0);	/* The entry can be reused */
+#endif
 	}
 #endif
 
@@ -2804,7 +4098,12 @@ FRESULT follow_path (	/* FR_OK(0): successful, !=0: error code */
 		for (;;) {
 			res = create_name(dp, &path);	/* Get a segment name of the path */
 			if (res != FR_OK) break;
+#if _FS_PATHCACHE
+			if (!(dp->fn[NSFLAG] & (NS_LAST | NS_DOT)) && pc_enter(dp)) continue;	/* Get into the sub-directory known in the cache */
+			res = pc_find(dp);				/* Find an object with the segment name */
+#else
 			res = dir_find(dp);				/* Find an object with the segment name */
+#endif
 			ns = dp->fn[NSFLAG];
 			if (res != FR_OK) {				/* Failed to find the object */
 				if (res == FR_NO_FILE) {	/* Object is not found */
@@ -2982,6 +4281,10 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 
 	fs->fs_type = 0;					/* Clear the file system object */
 	fs->drv = LD2PD(vol);				/* Bind the logical drive and a physical drive */
+#if _FS_WINCACHE
+	wc_purge(fs, 0, 0xFFFFFFFF);		/* Discard the sector cache */
+	fs->wcstamp = 0;
+#endif
 	stat = disk_initialize(fs->drv);	/* Initialize the physical drive */
 	if (stat & STA_NOINIT) { 			/* Check if the initialization succeeded */
 		return FR_NOT_READY;			/* Failed to initialize due to no medium or hard error */
@@ -3135,106 +4438,431 @@ FRESULT find_volume (	/* FR_OK(0): successful, !=0: any error occurred */
 #endif	/* !_FS_READONLY */
 	}
 
-	fs->fs_type = fmt;	/* FAT sub-type */
-	fs->id = ++Fsid;	/* File system mount ID */
-#if _USE_LFN == 1
-	fs->lfnbuf = LfnBuf;	/* Static LFN working buffer */
-#if _FS_EXFAT
-	fs->dirbuf = DirBuf;	/* Static directory block working buuffer */
-#endif
-#endif
-#if _FS_RPATH != 0
-	fs->cdir = 0;		/* Initialize current directory */
-#endif
-#if _FS_LOCK != 0		/* Clear file lock semaphores */
-	clear_lock(fs);
-#endif
-	return FR_OK;
+#if _FS_GETFREE_NB
+	fs->gf_clst = 0;	/* No free cluster count in progress */
+#endif
+#if _FS_PREALLOC
+	mem_set(fs->pa_use, 0, sizeof fs->pa_use);	/* No preallocation window */
+	fs->pa_stamp = 1;
+#endif
+#if _FS_LINKMAP
+	mem_set(fs->lmscl, 0, sizeof fs->lmscl);	/* No library-managed CLMT */
+#endif
+#if _FS_TAILCACHE
+	mem_set(fs->tc_scl, 0, sizeof fs->tc_scl);	/* No cached tail cluster */
+	fs->tc_next = 0;
+#endif
+#if _FS_DIRINDEX
+	mem_set(fs->ix_stat, 0, sizeof fs->ix_stat);	/* No directory indexed */
+	mem_set(fs->ix_use, 0, sizeof fs->ix_use);
+	fs->ix_stamp = 0;
+#endif
+#if _FS_DIRHINT
+	mem_set(fs->bh_ofs, 0, sizeof fs->bh_ofs);	/* No blank entry hint */
+	fs->bh_next = 0;
+#endif
+#if _FS_PATHCACHE
+	mem_set(fs->pcache, 0, sizeof fs->pcache);	/* Path resolution cache is empty */
+	fs->pcstamp = 0;
+#endif
+#if _FS_FREEMAP
+	fs->fm_valid = 0;	/* Free cluster map is to be built on demand */
+	fs->fm_nclst = fm_cover(fs, fmt);
+#endif
+#if _FS_LAZYMIRROR
+	for (fs->mshift = 0; (fs->fsize - 1) >> fs->mshift >= _FS_LAZYMIRROR * 8; fs->mshift++) ;	/* Granule size of the mirror dirty map */
+	mem_set(fs->mdirty, 0, _FS_LAZYMIRROR);
+#endif
+	fs->fs_type = fmt;	/* FAT sub-type */
+	fs->id = ++Fsid;	/* File system mount ID */
+#if _USE_LFN == 1
+	fs->lfnbuf = LfnBuf;	/* Static LFN working buffer */
+#if _FS_EXFAT
+	fs->dirbuf = DirBuf;	/* Static directory block working buuffer */
+#endif
+#endif
+#if _FS_RPATH != 0
+	fs->cdir = 0;		/* Initialize current directory */
+#endif
+#if _FS_LOCK != 0		/* Clear file lock semaphores */
+	clear_lock(fs);
+#endif
+	return FR_OK;
+}
+
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Check if the file/directory object is valid or not                    */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT validate (	/* Returns FR_OK or FR_INVALID_OBJECT */
+	void* dfp,		/* Pointer to the FIL/DIR object to check validity */
+	FATFS** fs		/* Pointer to pointer to the owner file system object to return */
+)
+{
+	_FDID *obj = (_FDID*)dfp;	/* Assuming .obj in the FIL/DIR is the first member */
+	FRESULT res;
+
+
+	if (!dfp || !obj->fs || !obj->fs->fs_type || obj->fs->id != obj->id || (disk_status(obj->fs->drv) & STA_NOINIT)) {
+		*fs = 0;				/* The object is invalid */
+		res = FR_INVALID_OBJECT;
+	} else {
+		*fs = obj->fs;			/* Owner file sytem object */
+		ENTER_FF(obj->fs);		/* Lock file system */
+		res = FR_OK;
+	}
+	return res;
+}
+
+
+
+
+/*---------------------------------------------------------------------------
+
+   Public Functions (FatFs API)
+
+----------------------------------------------------------------------------*/
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Mount/Unmount a Logical Drive                                         */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_mount (
+	FATFS* fs,			/* Pointer to the file system object (NULL:unmount)*/
+	const TCHAR* path,	/* Logical drive number to be mounted/unmounted */
+	BYTE opt			/* Mode option 0:Do not mount (delayed mount), 1:Mount immediately */
+)
+{
+	FATFS *cfs;
+	int vol;
+	FRESULT res, sres = FR_OK;
+	const TCHAR *rp = path;
+
+
+	vol = get_ldnumber(&rp);
+	if (vol < 0) return FR_INVALID_DRIVE;
+	cfs = FatFs[vol];					/* Pointer to fs object */
+
+	if (cfs) {
+#if _FS_WINCACHE || _FS_LAZYMIRROR
+		if (cfs->fs_type && !(disk_status(cfs->drv) & STA_NOINIT)) {	/* Flush deferred metadata writes */
+#if _FS_REENTRANT
+			if (!lock_fs(cfs)) return FR_TIMEOUT;	/* The volume is in use by another task */
+#endif
+			sres = sync_fs(cfs);		/* The volume is unregistered even if the flush failed */
+#if _FS_REENTRANT
+			unlock_fs(cfs, FR_OK);
+#endif
+		}
+#endif
+#if _FS_LOCK != 0
+		clear_lock(cfs);
+#endif
+#if _FS_REENTRANT						/* Discard sync object of the current volume */
+		if (!ff_del_syncobj(cfs->sobj)) return FR_INT_ERR;
+#endif
+		cfs->fs_type = 0;				/* Clear old fs object */
+	}
+
+	if (fs) {
+		fs->fs_type = 0;				/* Clear new fs object */
+#if _FS_FREEMAP
+		fs->fmap = 0;					/* Free cluster map is registered after mount */
+#endif
+#if _FS_DIRINDEX
+		fs->ixbuf = 0;					/* Directory name index area is registered after mount */
+#endif
+#if _FS_REENTRANT						/* Create sync object for the new volume */
+		if (!ff_cre_syncobj((BYTE)vol, &fs->sobj)) return FR_INT_ERR;
+#endif
+	}
+	FatFs[vol] = fs;					/* Register new fs object */
+
+	if (!fs || opt != 1) return sres;	/* Do not mount now, it will be mounted later */
+
+	res = find_volume(&path, &fs, 0);	/* Force mounted the volume */
+	if (res == FR_OK) res = sres;
+	LEAVE_FF(fs, res);
+}
+
+
+
+
+#if _FS_WINCACHE
+/*-----------------------------------------------------------------------*/
+/* Register FAT/Directory Cache to a File System Object                  */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_setcache (
+	FATFS* fs,			/* Pointer to the file system object (must not be mounted) */
+	WCSLOT* slot,		/* Pointer to the cache slot array (NULL:no cache) */
+	UINT nfat,			/* Number of slots for the FAT cache (top of the array) */
+	UINT ndir			/* Number of slots for the directory cache (following the FAT cache) */
+)
+{
+	if (!fs) return FR_INVALID_OBJECT;
+	if (fs->fs_type) return FR_DENIED;	/* The cache cannot be changed while the volume is mounted */
+
+	if (!slot) nfat = ndir = 0;
+	fs->wcache = (nfat + ndir) ? slot : 0;
+	fs->n_fatc = nfat; fs->n_dirc = ndir;
+	fs->wcstamp = 0;
+	fs->fc_hit = fs->fc_miss = fs->dc_hit = fs->dc_miss = 0;
+	fs->fc_next = 0;
+	wc_purge(fs, 0, 0xFFFFFFFF);		/* Make all slots empty */
+
+	return FR_OK;
+}
+
+#endif
+
+
+
+#if _FS_BURSTBUF
+/*-----------------------------------------------------------------------*/
+/* Register Burst Buffer to a File System Object                         */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_setburst (
+	FATFS* fs,			/* Pointer to the file system object (must not be mounted) */
+	void* buf,			/* Pointer to the burst buffer, DWORD aligned (NULL:no buffer) */
+	UINT nsect			/* Size of the burst buffer [sectors] */
+)
+{
+	if (!fs) return FR_INVALID_OBJECT;
+	if (fs->fs_type) return FR_DENIED;	/* The buffer cannot be changed while the volume is mounted */
+
+	fs->bbuf = nsect ? (BYTE*)buf : 0;
+	fs->n_bbuf = buf ? nsect : 0;
+
+	return FR_OK;
+}
+
+#endif
+
+
+
+
+#if _FS_FREEMAP
+/*-----------------------------------------------------------------------*/
+/* Register Free Cluster Map to a Volume                                 */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_setfreemap (
+	const TCHAR* path,	/* Path name of the logical drive number */
+	DWORD* map,			/* Pointer to the free cluster map area (NULL:no map) */
+	UINT nwords			/* Size of the map area [words], 1 bit per cluster */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+
+
+	res = find_volume(&path, &fs, 0);	/* Get logical drive (mounted) */
+	if (res == FR_OK) {
+		fs->fmap = nwords ? map : 0;
+		fs->fm_size = map ? nwords : 0;
+		fs->fm_valid = 0;				/* The map is to be built on demand */
+		fs->fm_nclst = fm_cover(fs, fs->fs_type);
+#if _FS_GETFREE_NB
+		fs->gf_clst = 0;				/* Restart the count in progress to build the map along with it */
+#endif
+	}
+
+	LEAVE_FF(fs, res);
+}
+
+#endif
+
+
+
+
+#if _FS_DIRINDEX
+/*-----------------------------------------------------------------------*/
+/* Register Directory Name Index Area to a Volume                        */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_setdirindex (
+	const TCHAR* path,	/* Path name of the logical drive number */
+	void* buf,			/* Pointer to the index area (NULL:no index) */
+	UINT size			/* Size of the index area [bytes], 1 byte per entry */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+
+
+	res = find_volume(&path, &fs, 0);	/* Get logical drive (mounted) */
+	if (res == FR_OK) {
+		fs->ix_size = buf ? size / _FS_DIRINDEX : 0;
+		fs->ixbuf = fs->ix_size ? (BYTE*)buf : 0;
+		mem_set(fs->ix_stat, 0, sizeof fs->ix_stat);	/* Indexes are to be built on demand */
+		mem_set(fs->ix_use, 0, sizeof fs->ix_use);
+		fs->ix_stamp = 0;
+	}
+
+	LEAVE_FF(fs, res);
+}
+
+#endif
+
+
+
+
+#if _FS_READAHEAD
+/*-----------------------------------------------------------------------*/
+/* Register Read-ahead Buffer to a File Object                           */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_setbuf (
+	FIL* fp,			/* Pointer to the open file object */
+	void* buf,			/* Pointer to the read-ahead buffer (NULL:no buffer) */
+	UINT nsect			/* Size of the read-ahead buffer [sectors] */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+
+
+	res = validate(&fp->obj, &fs);		/* Check validity of the file object */
+	if (res == FR_OK) {
+		fp->rabuf = nsect ? (BYTE*)buf : 0;
+		fp->ra_size = buf ? nsect : 0;
+		fp->ra_win = 1;
+		fp->ra_cnt = 0;					/* The buffer is empty */
+	}
+
+	LEAVE_FF(fs, res);
 }
 
+#endif
+
 
 
 
+#if _FS_WRITEBEHIND
 /*-----------------------------------------------------------------------*/
-/* Check if the file/directory object is valid or not                    */
+/* Write-back the file sector cache through the write-behind buffer      */
 /*-----------------------------------------------------------------------*/
 
 static
-FRESULT validate (	/* Returns FR_OK or FR_INVALID_OBJECT */
-	void* dfp,		/* Pointer to the FIL/DIR object to check validity */
-	FATFS** fs		/* Pointer to pointer to the owner file system object to return */
+DRESULT wb_flush (	/* Returns RES_OK or disk error */
+	FIL* fp			/* Pointer to the file object */
 )
 {
-	_FDID *obj = (_FDID*)dfp;	/* Assuming .obj in the FIL/DIR is the first member */
-	FRESULT res;
+	DRESULT dr = RES_OK;
 
 
-	if (!dfp || !obj->fs || !obj->fs->fs_type || obj->fs->id != obj->id || (disk_status(obj->fs->drv) & STA_NOINIT)) {
-		*fs = 0;				/* The object is invalid */
-		res = FR_INVALID_OBJECT;
-	} else {
-		*fs = obj->fs;			/* Owner file sytem object */
-		ENTER_FF(obj->fs);		/* Lock file system */
-		res = FR_OK;
+	if (fp->wb_cnt) {	/* Write out the buffered sectors in a transfer */
+		dr = disk_write(fp->obj.fs->drv, fp->wbbuf, fp->wb_sect, fp->wb_cnt);
+		if (dr == RES_OK) fp->wb_cnt = 0;	/* The data is kept in the buffer on error */
 	}
-	return res;
+	return dr;
 }
 
 
+static
+DRESULT wb_put (	/* Returns RES_OK or disk error */
+	FIL* fp			/* Pointer to the file object (fp->buf[] holds sector fp->sect) */
+)
+{
+	FATFS *fs = fp->obj.fs;
 
 
-/*---------------------------------------------------------------------------
+	if (!fp->wbbuf) return disk_write(fs->drv, fp->buf, fp->sect, 1);	/* No write-behind buffer */
 
-   Public Functions (FatFs API)
+	if (fp->wb_cnt && fp->sect != fp->wb_sect + fp->wb_cnt) {	/* Not following the buffered sectors? */
+		if (wb_flush(fp) != RES_OK) return RES_ERROR;
+	}
+	if (!fp->wb_cnt) {	/* Start a new run */
+		fp->wb_sect = fp->sect;
+		fp->wb_tick = ff_tick();
+	}
+	mem_cpy(fp->wbbuf + fp->wb_cnt * SS(fs), fp->buf, SS(fs));
+	if (++fp->wb_cnt >= fp->wb_size) return wb_flush(fp);	/* Write out when the buffer is full */
+	return RES_OK;
+}
+
+
+static
+DRESULT wb_expire (	/* Returns RES_OK or disk error */
+	FIL* fp			/* Pointer to the file object */
+)
+{
+	if (fp->wb_cnt && fp->wb_age && ff_tick() - fp->wb_tick >= fp->wb_age) {	/* Buffered data got too old? */
+		if (fp->flag & FA_DIRTY) {		/* Write out the sector cache along with it */
+			if (wb_put(fp) != RES_OK) return RES_ERROR;
+			fp->flag &= ~FA_DIRTY;
+		}
+		return wb_flush(fp);
+	}
+	return RES_OK;
+}
+
+#endif
 
-----------------------------------------------------------------------------*/
 
 
 
+#if _FS_WRITEBEHIND
 /*-----------------------------------------------------------------------*/
-/* Mount/Unmount a Logical Drive                                         */
+/* Register Write-behind Buffer to a File Object                         */
 /*-----------------------------------------------------------------------*/
 
-FRESULT f_mount (
-	FATFS* fs,			/* Pointer to the file system object (NULL:unmount)*/
-	const TCHAR* path,	/* Logical drive number to be mounted/unmounted */
-	BYTE opt			/* Mode option 0:Do not mount (delayed mount), 1:Mount immediately */
+FRESULT f_setwbuf (
+	FIL* fp,			/* Pointer to the open file object */
+	void* buf,			/* Pointer to the write-behind buffer (NULL:no buffer) */
+	UINT nsect,			/* Size of the write-behind buffer [sectors] */
+	DWORD maxage		/* Maximum age of the buffered data [ms] (0:no limit) */
 )
 {
-	FATFS *cfs;
-	int vol;
 	FRESULT res;
-	const TCHAR *rp = path;
+	FATFS *fs;
 
 
-	vol = get_ldnumber(&rp);
-	if (vol < 0) return FR_INVALID_DRIVE;
-	cfs = FatFs[vol];					/* Pointer to fs object */
+	res = validate(&fp->obj, &fs);		/* Check validity of the file object */
+	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);
+	if (!(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);	/* Check access mode */
 
-	if (cfs) {
-#if _FS_LOCK != 0
-		clear_lock(cfs);
-#endif
-#if _FS_REENTRANT						/* Discard sync object of the current volume */
-		if (!ff_del_syncobj(cfs->sobj)) return FR_INT_ERR;
-#endif
-		cfs->fs_type = 0;				/* Clear old fs object */
-	}
+	if (wb_flush(fp) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Write out the current buffer */
+	fp->wbbuf = nsect ? (BYTE*)buf : 0;
+	fp->wb_size = buf ? nsect : 0;
+	fp->wb_age = maxage;
 
-	if (fs) {
-		fs->fs_type = 0;				/* Clear new fs object */
-#if _FS_REENTRANT						/* Create sync object for the new volume */
-		if (!ff_cre_syncobj((BYTE)vol, &fs->sobj)) return FR_INT_ERR;
-#endif
-	}
-	FatFs[vol] = fs;					/* Register new fs object */
+	LEAVE_FF(fs, FR_OK);
+}
 
-	if (!fs || opt != 1) return FR_OK;	/* Do not mount now, it will be mounted later */
 
-	res = find_volume(&path, &fs, 0);	/* Force mounted the volume */
-	LEAVE_FF(fs, res);
+
+
+/*-----------------------------------------------------------------------*/
+/* Write Out Aged Data in the Write-behind Buffer                        */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_wbpoll (
+	FIL* fp		/* Pointer to the open file object */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+
+
+	res = validate(&fp->obj, &fs);		/* Check validity of the file object */
+	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);
+
+	if (wb_expire(fp) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Write out the buffered data if it got too old */
+
+	LEAVE_FF(fs, FR_OK);
 }
 
+#endif
+
 
 
 
@@ -3393,6 +5021,17 @@ FRESULT f_open (
 			}
 #if _USE_FASTSEEK
 			fp->cltbl = 0;			/* Disable fast seek mode */
+#endif
+#if _FS_LINKMAP
+			fp->lmap = 0;			/* Library-managed CLMT is built on demand */
+#endif
+#if _FS_READAHEAD
+			fp->rabuf = 0;			/* Disable read-ahead */
+			fp->ra_cnt = 0;
+#endif
+#if _FS_WRITEBEHIND
+			fp->wbbuf = 0;			/* Disable write-behind */
+			fp->wb_cnt = 0;
 #endif
 			fp->obj.fs = fs;	 	/* Validate the file object */
 			fp->obj.id = fs->id;
@@ -3408,7 +5047,11 @@ FRESULT f_open (
 				fp->fptr = fp->obj.objsize;			/* Offset to seek */
 				bcs = (DWORD)fs->csize * SS(fs);	/* Cluster size in byte */
 				clst = fp->obj.sclust;				/* Follow the cluster chain */
-				for (ofs = fp->obj.objsize; res == FR_OK && ofs > bcs; ofs -= bcs) {
+				ofs = fp->obj.objsize;
+#if _FS_TAILCACHE
+				ofs -= (FSIZE_t)tc_find(fs, clst, ofs, &clst) * bcs;	/* Start from the cached cluster if possible */
+#endif
+				for ( ; res == FR_OK && ofs > bcs; ofs -= bcs) {
 					clst = get_fat(&fp->obj, clst);
 					if (clst <= 1) res = FR_INT_ERR;
 					if (clst == 0xFFFFFFFF) res = FR_DISK_ERR;
@@ -3439,107 +5082,211 @@ FRESULT f_open (
 
 
 
+#if _FS_READAHEAD
+/*-----------------------------------------------------------------------*/
+/* Fill the file sector cache through the read-ahead buffer              */
+/*-----------------------------------------------------------------------*/
+
+static
+DRESULT ra_read (	/* Returns RES_OK or disk error */
+	FIL* fp,		/* Pointer to the file object */
+	DWORD sect		/* Sector to be loaded into fp->buf[] (in the cluster fp->clust) */
+)
+{
+	FATFS *fs = fp->obj.fs;
+	DWORD clst, ncl;
+	UINT n, win;
+	FSIZE_t ofs;
+
+
+	if (!fp->rabuf) return disk_read(fs->drv, fp->buf, sect, 1);	/* No read-ahead buffer */
+
+	if (sect - fp->ra_sect < fp->ra_cnt) {	/* Hit in the read-ahead buffer */
+		mem_cpy(fp->buf, fp->rabuf + (sect - fp->ra_sect) * SS(fs), SS(fs));
+		return RES_OK;
+	}
+
+	/* Adapt the prefetch size to the access pattern */
+	if (fp->ra_cnt && sect == fp->ra_sect + fp->ra_cnt) {	/* Sequential access: grow */
+		fp->ra_win = (fp->ra_win * 2 < fp->ra_size) ? fp->ra_win * 2 : fp->ra_size;
+	} else {											/* Random access: shrink */
+		fp->ra_win = 1;
+	}
+	win = fp->ra_win;
+	ofs = fp->fptr - fp->fptr % SS(fs);				/* Do not prefetch beyond the end of file */
+	if (fp->obj.objsize > ofs && (fp->obj.objsize - ofs + SS(fs) - 1) / SS(fs) < win) {
+		win = (UINT)((fp->obj.objsize - ofs + SS(fs) - 1) / SS(fs));
+	}
+	n = fs->csize - (UINT)((sect - fs->database) % fs->csize);	/* Sectors left in the cluster */
+	for (clst = fp->clust; n < win; n += fs->csize) {	/* Extend it over physically contiguous clusters */
+		ncl = get_fat(&fp->obj, clst);
+		if (ncl != clst + 1) break;
+		clst = ncl;
+	}
+	if (n > win) n = win;
+
+	fp->ra_cnt = 0;
+	if (disk_read(fs->drv, fp->rabuf, sect, n) != RES_OK) return RES_ERROR;
+	fp->ra_sect = sect; fp->ra_cnt = n;
+	mem_cpy(fp->buf, fp->rabuf, SS(fs));
+	return RES_OK;
+}
+
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Read File                                                             */
 /*-----------------------------------------------------------------------*/
 
-FRESULT f_read (
-	FIL* fp, 	/* Pointer to the file object */
-	void* buff,	/* Pointer to data buffer */
-	UINT btr,	/* Number of bytes to read */
-	UINT* br	/* Pointer to number of bytes read */
+FRESULT f_readv (
+	FIL* fp, 			/* Pointer to the file object */
+	const FIOVEC* iov,	/* Pointer to the array of data buffers */
+	UINT iovcnt,		/* Number of items in the array */
+	UINT* br			/* Pointer to number of bytes read */
 )
 {
 	FRESULT res;
 	FATFS *fs;
 	DWORD clst, sect;
 	FSIZE_t remain;
-	UINT rcnt, cc, csect;
-	BYTE *rbuff = (BYTE*)buff;
+	UINT btr, rcnt, cc, csect;
+#if _FS_COALESCE
+	DWORD ncl;
+	UINT n;
+#endif
+	BYTE *rbuff;
 
 
 	*br = 0;	/* Clear read byte counter */
 	res = validate(fp, &fs);
 	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
 	if (!(fp->flag & FA_READ)) LEAVE_FF(fs, FR_DENIED); /* Check access mode */
-	remain = fp->obj.objsize - fp->fptr;
-	if (btr > remain) btr = (UINT)remain;		/* Truncate btr by remaining bytes */
-
-	for ( ;  btr;								/* Repeat until all data read */
-		rbuff += rcnt, fp->fptr += rcnt, *br += rcnt, btr -= rcnt) {
-		if (fp->fptr % SS(fs) == 0) {			/* On the sector boundary? */
-			csect = (UINT)(fp->fptr / SS(fs) & (fs->csize - 1));	/* Sector offset in the cluster */
-			if (csect == 0) {					/* On the cluster boundary? */
-				if (fp->fptr == 0) {			/* On the top of the file? */
-					clst = fp->obj.sclust;		/* Follow cluster chain from the origin */
-				} else {						/* Middle or end of the file */
+#if _FS_WRITEBEHIND
+	if (wb_flush(fp) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Buffered sectors are to be read from the disk */
+#endif
+#if _FS_LINKMAP
+	lm_check(fp);
+#endif
+	for ( ; iovcnt; iov++, iovcnt--) {			/* Repeat for each buffer */
+		rbuff = (BYTE*)iov->buf;
+		btr = iov->len;
+		remain = fp->obj.objsize - fp->fptr;
+		if (btr > remain) btr = (UINT)remain;		/* Truncate btr by remaining bytes */
+
+		for ( ;  btr;								/* Repeat until all data read */
+			rbuff += rcnt, fp->fptr += rcnt, *br += rcnt, btr -= rcnt) {
+			if (fp->fptr % SS(fs) == 0) {			/* On the sector boundary? */
+				csect = (UINT)(fp->fptr / SS(fs) & (fs->csize - 1));	/* Sector offset in the cluster */
+				if (csect == 0) {					/* On the cluster boundary? */
+					if (fp->fptr == 0) {			/* On the top of the file? */
+						clst = fp->obj.sclust;		/* Follow cluster chain from the origin */
+					} else {						/* Middle or end of the file */
 #if _USE_FASTSEEK
-					if (fp->cltbl) {
-						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
-					} else
+						if (fp->cltbl) {
+							clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
+						} else
 #endif
-					{
-						clst = get_fat(&fp->obj, fp->clust);	/* Follow cluster chain on the FAT */
+						{
+							clst = get_fat(&fp->obj, fp->clust);	/* Follow cluster chain on the FAT */
+						}
 					}
+					if (clst < 2) ABORT(fs, FR_INT_ERR);
+					if (clst == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
+					fp->clust = clst;				/* Update current cluster */
 				}
-				if (clst < 2) ABORT(fs, FR_INT_ERR);
-				if (clst == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
-				fp->clust = clst;				/* Update current cluster */
-			}
-			sect = clust2sect(fs, fp->clust);	/* Get current sector */
-			if (!sect) ABORT(fs, FR_INT_ERR);
-			sect += csect;
-			cc = btr / SS(fs);					/* When remaining bytes >= sector size, */
-			if (cc) {							/* Read maximum contiguous sectors directly */
-				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
-					cc = fs->csize - csect;
-				}
-				if (disk_read(fs->drv, rbuff, sect, cc) != RES_OK) {
-					ABORT(fs, FR_DISK_ERR);
-				}
+				sect = clust2sect(fs, fp->clust);	/* Get current sector */
+				if (!sect) ABORT(fs, FR_INT_ERR);
+				sect += csect;
+				cc = btr / SS(fs);					/* When remaining bytes >= sector size, */
+				if (cc) {							/* Read maximum contiguous sectors directly */
+					if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
+#if _FS_COALESCE
+						n = fs->csize - csect;		/* Sectors left in the current cluster */
+						if (cc > _FS_COALESCE) cc = (_FS_COALESCE > n) ? _FS_COALESCE : n;
+						for (clst = fp->clust; n < cc; n += fs->csize) {	/* Extend the transfer over physically contiguous clusters */
+#if _USE_FASTSEEK
+							if (fp->cltbl) {
+								ncl = clmt_clust(fp, fp->fptr + (FSIZE_t)n * SS(fs));
+							} else
+#endif
+							{
+								ncl = get_fat(&fp->obj, clst);
+							}
+							if (ncl != clst + 1) break;	/* Fragmented, end of chain or error (checked at next cluster) */
+							clst = ncl;
+						}
+						if (cc > n) cc = n;
+						fp->clust = clst;			/* Last cluster of the transfer */
+#else
+						cc = fs->csize - csect;
+#endif
+					}
+					if (disk_read(fs->drv, rbuff, sect, cc) != RES_OK) {
+						ABORT(fs, FR_DISK_ERR);
+					}
 #if !_FS_READONLY && _FS_MINIMIZE <= 2			/* Replace one of the read sectors with cached data if it contains a dirty sector */
 #if _FS_TINY
-				if (fs->wflag && fs->winsect - sect < cc) {
-					mem_cpy(rbuff + ((fs->winsect - sect) * SS(fs)), fs->win, SS(fs));
-				}
+					if (fs->wflag && fs->winsect - sect < cc) {
+						mem_cpy(rbuff + ((fs->winsect - sect) * SS(fs)), fs->win, SS(fs));
+					}
 #else
-				if ((fp->flag & FA_DIRTY) && fp->sect - sect < cc) {
-					mem_cpy(rbuff + ((fp->sect - sect) * SS(fs)), fp->buf, SS(fs));
-				}
+					if ((fp->flag & FA_DIRTY) && fp->sect - sect < cc) {
+						mem_cpy(rbuff + ((fp->sect - sect) * SS(fs)), fp->buf, SS(fs));
+					}
 #endif
 #endif
-				rcnt = SS(fs) * cc;				/* Number of bytes transferred */
-				continue;
-			}
+					rcnt = SS(fs) * cc;				/* Number of bytes transferred */
+					continue;
+				}
 #if !_FS_TINY
-			if (fp->sect != sect) {			/* Load data sector if not in cache */
+				if (fp->sect != sect) {			/* Load data sector if not in cache */
 #if !_FS_READONLY
-				if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
-					if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
-					fp->flag &= ~FA_DIRTY;
-				}
+					if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
+						if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+						fp->flag &= ~FA_DIRTY;
+					}
 #endif
-				if (disk_read(fs->drv, fp->buf, sect, 1) != RES_OK)	{	/* Fill sector cache */
-					ABORT(fs, FR_DISK_ERR);
+					if (RA_READ(fp, sect) != RES_OK)	{	/* Fill sector cache */
+						ABORT(fs, FR_DISK_ERR);
+					}
 				}
-			}
 #endif
-			fp->sect = sect;
-		}
-		rcnt = SS(fs) - (UINT)fp->fptr % SS(fs);	/* Number of bytes left in the sector */
-		if (rcnt > btr) rcnt = btr;					/* Clip it by btr if needed */
+				fp->sect = sect;
+			}
+			rcnt = SS(fs) - (UINT)fp->fptr % SS(fs);	/* Number of bytes left in the sector */
+			if (rcnt > btr) rcnt = btr;					/* Clip it by btr if needed */
 #if _FS_TINY
-		if (move_window(fs, fp->sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window */
-		mem_cpy(rbuff, fs->win + fp->fptr % SS(fs), rcnt);	/* Extract partial sector */
+			if (move_window(fs, fp->sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window */
+			mem_cpy(rbuff, fs->win + fp->fptr % SS(fs), rcnt);	/* Extract partial sector */
 #else
-		mem_cpy(rbuff, fp->buf + fp->fptr % SS(fs), rcnt);	/* Extract partial sector */
+			mem_cpy(rbuff, fp->buf + fp->fptr % SS(fs), rcnt);	/* Extract partial sector */
 #endif
+		}
 	}
 
 	LEAVE_FF(fs, FR_OK);
 }
 
 
+FRESULT f_read (
+	FIL* fp, 	/* Pointer to the file object */
+	void* buff,	/* Pointer to data buffer */
+	UINT btr,	/* Number of bytes to read */
+	UINT* br	/* Pointer to number of bytes read */
+)
+{
+	FIOVEC iov;
+
+
+	iov.buf = buff;
+	iov.len = btr;
+	return f_readv(fp, &iov, 1, br);
+}
+
+
 
 
 #if !_FS_READONLY
@@ -3547,125 +5294,205 @@ FRESULT f_read (
 /* Write File                                                            */
 /*-----------------------------------------------------------------------*/
 
-FRESULT f_write (
+static
+DWORD next_clust (	/* 0:Disk full, 1:Internal error, 0xFFFFFFFF:Disk error, >=2:Cluster# */
+	FIL* fp,		/* Pointer to the file object */
+	DWORD clst,		/* Current cluster */
+	FSIZE_t ofs		/* File offset of the top of the next cluster */
+)
+{
+#if _USE_FASTSEEK
+	DWORD ncl;
+
+
+	if (fp->cltbl) {
+		ncl = clmt_clust(fp, ofs);	/* Get cluster# from the CLMT */
+#if _FS_LINKMAP
+		if (ncl == 0 && fp->lmap == 1) {	/* Stretch the chain beyond the library-managed CLMT */
+#if _FS_PREALLOC
+			pa_open(fp->obj.fs, &fp->obj, clst);
+#endif
+			ncl = create_chain(&fp->obj, clst);
+			if (ncl >= 2 && ncl != 0xFFFFFFFF) lm_append(fp, ncl);
+		}
+#endif
+		return ncl;
+	}
+#endif
+#if _FS_PREALLOC
+	if (ofs >= fp->obj.objsize) pa_open(fp->obj.fs, &fp->obj, clst);	/* Appending: reserve following clusters for the file */
+#endif
+	return create_chain(&fp->obj, clst);	/* Follow or stretch cluster chain on the FAT */
+}
+
+
+FRESULT f_writev (
 	FIL* fp,			/* Pointer to the file object */
-	const void* buff,	/* Pointer to the data to be written */
-	UINT btw,			/* Number of bytes to write */
+	const FIOVEC* iov,	/* Pointer to the array of data to be written */
+	UINT iovcnt,		/* Number of items in the array */
 	UINT* bw			/* Pointer to number of bytes written */
 )
 {
 	FRESULT res;
 	FATFS *fs;
 	DWORD clst, sect;
-	UINT wcnt, cc, csect;
-	const BYTE *wbuff = (const BYTE*)buff;
+	UINT btw, wcnt, cc, csect;
+#if _FS_COALESCE
+	DWORD ncl;
+	UINT n;
+#endif
+	const BYTE *wbuff;
 
 
 	*bw = 0;	/* Clear write byte counter */
 	res = validate(fp, &fs);
 	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
 	if (!(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);	/* Check access mode */
+#if _FS_READAHEAD
+	fp->ra_cnt = 0;		/* Read-ahead data is no longer valid */
+#endif
+#if _FS_LINKMAP
+	lm_check(fp);
+#endif
 
-	/* Check fptr wrap-around (file size cannot exceed the limit on each FAT specs) */
-	if ((_FS_EXFAT && fs->fs_type == FS_EXFAT && fp->fptr + btw < fp->fptr)
-		|| (DWORD)fp->fptr + btw < (DWORD)fp->fptr) {
-		btw = (UINT)(0xFFFFFFFF - (DWORD)fp->fptr);
-	}
-
-	for ( ;  btw;							/* Repeat until all data written */
-		wbuff += wcnt, fp->fptr += wcnt, fp->obj.objsize = (fp->fptr > fp->obj.objsize) ? fp->fptr : fp->obj.objsize, *bw += wcnt, btw -= wcnt) {
-		if (fp->fptr % SS(fs) == 0) {		/* On the sector boundary? */
-			csect = (UINT)(fp->fptr / SS(fs)) & (fs->csize - 1);	/* Sector offset in the cluster */
-			if (csect == 0) {				/* On the cluster boundary? */
-				if (fp->fptr == 0) {		/* On the top of the file? */
-					clst = fp->obj.sclust;	/* Follow from the origin */
-					if (clst == 0) {		/* If no cluster is allocated, */
-						clst = create_chain(&fp->obj, 0);	/* create a new cluster chain */
-					}
-				} else {					/* On the middle or end of the file */
-#if _USE_FASTSEEK
-					if (fp->cltbl) {
-						clst = clmt_clust(fp, fp->fptr);	/* Get cluster# from the CLMT */
-					} else
+	for ( ; iovcnt; iov++, iovcnt--) {		/* Repeat for each data */
+		wbuff = (const BYTE*)iov->buf;
+		btw = iov->len;
+
+		/* Check fptr wrap-around (file size cannot exceed the limit on each FAT specs) */
+		if ((_FS_EXFAT && fs->fs_type == FS_EXFAT && fp->fptr + btw < fp->fptr)
+			|| (DWORD)fp->fptr + btw < (DWORD)fp->fptr) {
+			btw = (UINT)(0xFFFFFFFF - (DWORD)fp->fptr);
+		}
+
+		for ( ;  btw;							/* Repeat until all data written */
+			wbuff += wcnt, fp->fptr += wcnt, fp->obj.objsize = (fp->fptr > fp->obj.objsize) ? fp->fptr : fp->obj.objsize, *bw += wcnt, btw -= wcnt) {
+			if (fp->fptr % SS(fs) == 0) {		/* On the sector boundary? */
+				csect = (UINT)(fp->fptr / SS(fs)) & (fs->csize - 1);	/* Sector offset in the cluster */
+				if (csect == 0) {				/* On the cluster boundary? */
+					if (fp->fptr == 0) {		/* On the top of the file? */
+						clst = fp->obj.sclust;	/* Follow from the origin */
+						if (clst == 0) {		/* If no cluster is allocated, */
+							clst = create_chain(&fp->obj, 0);	/* create a new cluster chain */
+#if _FS_PREALLOC
+							if (clst >= 2 && clst != 0xFFFFFFFF) {
+								fp->obj.sclust = clst;
+								pa_open(fs, &fp->obj, clst);	/* Reserve following clusters for the file */
+							}
 #endif
-					{
-						clst = create_chain(&fp->obj, fp->clust);	/* Follow or stretch cluster chain on the FAT */
+						}
+					} else {					/* On the middle or end of the file */
+						clst = next_clust(fp, fp->clust, fp->fptr);	/* Follow or stretch cluster chain */
 					}
+					if (clst == 0) break;		/* Could not allocate a new cluster (disk full) */
+					if (clst == 1) ABORT(fs, FR_INT_ERR);
+					if (clst == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
+					fp->clust = clst;			/* Update current cluster */
+					if (fp->obj.sclust == 0) fp->obj.sclust = clst;	/* Set start cluster if the first write */
 				}
-				if (clst == 0) break;		/* Could not allocate a new cluster (disk full) */
-				if (clst == 1) ABORT(fs, FR_INT_ERR);
-				if (clst == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
-				fp->clust = clst;			/* Update current cluster */
-				if (fp->obj.sclust == 0) fp->obj.sclust = clst;	/* Set start cluster if the first write */
-			}
 #if _FS_TINY
-			if (fs->winsect == fp->sect && sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Write-back sector cache */
+				if (fs->winsect == fp->sect && sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Write-back sector cache */
 #else
-			if (fp->flag & FA_DIRTY) {		/* Write-back sector cache */
-				if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
-				fp->flag &= ~FA_DIRTY;
-			}
-#endif
-			sect = clust2sect(fs, fp->clust);	/* Get current sector */
-			if (!sect) ABORT(fs, FR_INT_ERR);
-			sect += csect;
-			cc = btw / SS(fs);				/* When remaining bytes >= sector size, */
-			if (cc) {						/* Write maximum contiguous sectors directly */
-				if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
-					cc = fs->csize - csect;
-				}
-				if (disk_write(fs->drv, wbuff, sect, cc) != RES_OK) {
-					ABORT(fs, FR_DISK_ERR);
+				if (fp->flag & FA_DIRTY) {		/* Write-back sector cache */
+					if (WB_PUT(fp) != RES_OK) ABORT(fs, FR_DISK_ERR);
+					fp->flag &= ~FA_DIRTY;
 				}
+#endif
+				sect = clust2sect(fs, fp->clust);	/* Get current sector */
+				if (!sect) ABORT(fs, FR_INT_ERR);
+				sect += csect;
+				cc = btw / SS(fs);				/* When remaining bytes >= sector size, */
+				if (cc) {						/* Write maximum contiguous sectors directly */
+					if (csect + cc > fs->csize) {	/* Clip at cluster boundary */
+#if _FS_COALESCE
+						n = fs->csize - csect;		/* Sectors left in the current cluster */
+						if (cc > _FS_COALESCE) cc = (_FS_COALESCE > n) ? _FS_COALESCE : n;
+						for (clst = fp->clust; n < cc; n += fs->csize) {	/* Link the following clusters up front while contiguous */
+							ncl = next_clust(fp, clst, fp->fptr + (FSIZE_t)n * SS(fs));
+							if (ncl == 1) ABORT(fs, FR_INT_ERR);
+							if (ncl == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
+							if (ncl != clst + 1) break;	/* Fragmented or disk full (checked at next cluster) */
+							clst = ncl;
+						}
+						if (cc > n) cc = n;
+						fp->clust = clst;			/* Last cluster of the transfer */
+#else
+						cc = fs->csize - csect;
+#endif
+					}
+					if (disk_write(fs->drv, wbuff, sect, cc) != RES_OK) {
+						ABORT(fs, FR_DISK_ERR);
+					}
 #if _FS_MINIMIZE <= 2
 #if _FS_TINY
-				if (fs->winsect - sect < cc) {	/* Refill sector cache if it gets invalidated by the direct write */
-					mem_cpy(fs->win, wbuff + ((fs->winsect - sect) * SS(fs)), SS(fs));
-					fs->wflag = 0;
-				}
+					if (fs->winsect - sect < cc) {	/* Refill sector cache if it gets invalidated by the direct write */
+						mem_cpy(fs->win, wbuff + ((fs->winsect - sect) * SS(fs)), SS(fs));
+						fs->wflag = 0;
+					}
 #else
-				if (fp->sect - sect < cc) { /* Refill sector cache if it gets invalidated by the direct write */
-					mem_cpy(fp->buf, wbuff + ((fp->sect - sect) * SS(fs)), SS(fs));
-					fp->flag &= ~FA_DIRTY;
-				}
+					if (fp->sect - sect < cc) { /* Refill sector cache if it gets invalidated by the direct write */
+						mem_cpy(fp->buf, wbuff + ((fp->sect - sect) * SS(fs)), SS(fs));
+						fp->flag &= ~FA_DIRTY;
+					}
 #endif
 #endif
-				wcnt = SS(fs) * cc;		/* Number of bytes transferred */
-				continue;
-			}
+					wcnt = SS(fs) * cc;		/* Number of bytes transferred */
+					continue;
+				}
 #if _FS_TINY
-			if (fp->fptr >= fp->obj.objsize) {	/* Avoid silly cache filling at growing edge */
-				if (sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);
-				fs->winsect = sect;
-			}
+				if (fp->fptr >= fp->obj.objsize) {	/* Avoid silly cache filling at growing edge */
+					if (sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);
+					fs->winsect = sect;
+				}
 #else
-			if (fp->sect != sect) {		/* Fill sector cache with file data */
-				if (fp->fptr < fp->obj.objsize &&
-					disk_read(fs->drv, fp->buf, sect, 1) != RES_OK) {
-						ABORT(fs, FR_DISK_ERR);
+				if (fp->sect != sect) {		/* Fill sector cache with file data */
+					if (fp->fptr < fp->obj.objsize &&
+						disk_read(fs->drv, fp->buf, sect, 1) != RES_OK) {
+							ABORT(fs, FR_DISK_ERR);
+					}
 				}
-			}
 #endif
-			fp->sect = sect;
-		}
-		wcnt = SS(fs) - (UINT)fp->fptr % SS(fs);	/* Number of bytes left in the sector */
-		if (wcnt > btw) wcnt = btw;					/* Clip it by btw if needed */
+				fp->sect = sect;
+			}
+			wcnt = SS(fs) - (UINT)fp->fptr % SS(fs);	/* Number of bytes left in the sector */
+			if (wcnt > btw) wcnt = btw;					/* Clip it by btw if needed */
 #if _FS_TINY
-		if (move_window(fs, fp->sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window */
-		mem_cpy(fs->win + fp->fptr % SS(fs), wbuff, wcnt);	/* Fit data to the sector */
-		fs->wflag = 1;
+			if (move_window(fs, fp->sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window */
+			mem_cpy(fs->win + fp->fptr % SS(fs), wbuff, wcnt);	/* Fit data to the sector */
+			fs->wflag = 1;
 #else
-		mem_cpy(fp->buf + fp->fptr % SS(fs), wbuff, wcnt);	/* Fit data to the sector */
-		fp->flag |= FA_DIRTY;
+			mem_cpy(fp->buf + fp->fptr % SS(fs), wbuff, wcnt);	/* Fit data to the sector */
+			fp->flag |= FA_DIRTY;
 #endif
+		}
+		if (btw) break;						/* Could not write all data (disk full) */
 	}
 
 	fp->flag |= FA_MODIFIED;						/* Set file change flag */
+#if _FS_WRITEBEHIND
+	if (wb_expire(fp) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Write out the buffered data if it got too old */
+#endif
 
 	LEAVE_FF(fs, FR_OK);
 }
 
 
+FRESULT f_write (
+	FIL* fp,			/* Pointer to the file object */
+	const void* buff,	/* Pointer to the data to be written */
+	UINT btw,			/* Number of bytes to write */
+	UINT* bw			/* Pointer to number of bytes written */
+)
+{
+	FIOVEC iov;
+
+
+	iov.buf = (void*)buff;
+	iov.len = btw;
+	return f_writev(fp, &iov, 1, bw);
+}
+
+
 
 
 /*-----------------------------------------------------------------------*/
@@ -3688,9 +5515,12 @@ FRESULT f_sync (
 		if (fp->flag & FA_MODIFIED) {	/* Is there any change to the file? */
 #if !_FS_TINY
 			if (fp->flag & FA_DIRTY) {	/* Write-back cached data if needed */
-				if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) LEAVE_FF(fs, FR_DISK_ERR);
+				if (WB_PUT(fp) != RES_OK) LEAVE_FF(fs, FR_DISK_ERR);
 				fp->flag &= ~FA_DIRTY;
 			}
+#endif
+#if _FS_WRITEBEHIND
+			if (wb_flush(fp) != RES_OK) LEAVE_FF(fs, FR_DISK_ERR);	/* Write out the buffered sectors */
 #endif
 			/* Update the directory entry */
 			tm = GET_FATTIME();				/* Modified time */
@@ -3754,16 +5584,29 @@ FRESULT f_close (
 	FIL* fp		/* Pointer to the file object to be closed */
 )
 {
-	FRESULT res;
+	FRESULT res, sres;
 	FATFS *fs;
 
 #if !_FS_READONLY
-	res = f_sync(fp);					/* Flush cached data */
-	if (res == FR_OK)
+	sres = f_sync(fp);					/* Flush cached data */
+#else
+	sres = FR_OK;
 #endif
-	{
-		res = validate(fp, &fs);	/* Lock volume */
+	res = validate(fp, &fs);	/* Lock volume */
+	if (res == FR_OK) {
+#if _FS_PREALLOC
+		pa_release(fs, &fp->obj);	/* Release the preallocation window (even if the flush failed) */
+#endif
+#if _FS_LINKMAP
+		lm_release(fp, 0);			/* Release the library-managed CLMT (even if the flush failed) */
+#endif
+		res = sres;
 		if (res == FR_OK) {
+#if _FS_TAILCACHE
+			if (fp->fptr > 0 && fp->clust >= 2) {	/* Keep the current cluster for the next open */
+				tc_store(fs, fp->obj.sclust, (DWORD)((fp->fptr - 1) / ((DWORD)fs->csize * SS(fs))), fp->clust);
+			}
+#endif
 #if _FS_LOCK != 0
 			res = dec_lock(fp->obj.lockid);	/* Decrement file open counter */
 			if (res == FR_OK)
@@ -3771,10 +5614,10 @@ FRESULT f_close (
 			{
 				fp->obj.fs = 0;			/* Invalidate file object */
 			}
+		}
 #if _FS_REENTRANT
-			unlock_fs(fs, FR_OK);		/* Unlock volume */
+		unlock_fs(fs, FR_OK);		/* Unlock volume */
 #endif
-		}
 	}
 	return res;
 }
@@ -3949,9 +5792,30 @@ FRESULT f_lseek (
 #if _USE_FASTSEEK
 	DWORD cl, pcl, ncl, tcl, dsc, tlen, ulen, *tbl;
 #endif
+#if _FS_LINKMAP
+	DWORD lmix = 0, lmcl = 0;
+#endif
 
 	res = validate(fp, &fs);		/* Check validity of the object */
 	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
+#if _FS_WRITEBEHIND
+	if (wb_flush(fp) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Writes after the seek do not follow the buffered sectors */
+#endif
+#if _FS_LINKMAP
+	lm_check(fp);
+	if (ofs == CREATE_LINKMAP && (!fp->cltbl || fp->lmap == 1)) {
+		LEAVE_FF(fs, FR_INVALID_PARAMETER);	/* CLMT to be created is not given by the application */
+	}
+	if (fp->lmap == 1 && ofs > fp->obj.objsize && (fp->flag & FA_WRITE)) {
+		lm_release(fp, 0);			/* Expand the file with normal seek and map it again later */
+	}
+	bcs = (DWORD)fs->csize * SS(fs);
+	if (!fp->cltbl && fp->lmap == 0 && fp->obj.sclust && ofs > 0 && ofs <= fp->obj.objsize
+		&& fp->fptr > 0 && (ofs - 1) / bcs < (fp->fptr - 1) / bcs) {	/* Map the chain only when the seek goes back */
+		res = lm_build(fp, (DWORD)((ofs - 1) / bcs), &lmix, &lmcl);
+		if (res != FR_OK) ABORT(fs, res);
+	}
+#endif
 #if _USE_FASTSEEK
 	if (fp->cltbl) {	/* Fast seek */
 		if (ofs == CREATE_LINKMAP) {	/* Create CLMT */
@@ -3995,7 +5859,7 @@ FRESULT f_lseek (
 						fp->flag &= ~FA_DIRTY;
 					}
 #endif
-					if (disk_read(fs->drv, fp->buf, dsc, 1) != RES_OK) {	/* Load current sector */
+					if (RA_READ(fp, dsc) != RES_OK) {	/* Load current sector */
 						ABORT(fs, FR_DISK_ERR);
 					}
 #endif
@@ -4029,6 +5893,18 @@ FRESULT f_lseek (
 					if (clst == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
 					fp->obj.sclust = clst;
 				}
+#endif
+#if _FS_TAILCACHE
+				fp->fptr = (FSIZE_t)tc_find(fs, clst, ofs, &clst) * bcs;	/* Start from the cached cluster if it is on the way */
+				ofs -= fp->fptr;
+#endif
+#if _FS_LINKMAP
+				if (lmcl && (FSIZE_t)lmix * bcs > fp->fptr) {	/* Start from the cluster reached by the mapping */
+					ofs += fp->fptr;
+					fp->fptr = (FSIZE_t)lmix * bcs;
+					ofs -= fp->fptr;
+					clst = lmcl;
+				}
 #endif
 				fp->clust = clst;
 			}
@@ -4065,7 +5941,7 @@ FRESULT f_lseek (
 				fp->flag &= ~FA_DIRTY;
 			}
 #endif
-			if (disk_read(fs->drv, fp->buf, nsect, 1) != RES_OK) {	/* Fill sector cache */
+			if (RA_READ(fp, nsect) != RES_OK) {	/* Fill sector cache */
 				ABORT(fs, FR_DISK_ERR);
 			}
 #endif
@@ -4084,6 +5960,108 @@ FRESULT f_lseek (
 
 
 
+#if _USE_PREAD
+/*-----------------------------------------------------------------------*/
+/* Read/Write File at a Position                                         */
+/*-----------------------------------------------------------------------*/
+
+static
+FRESULT put_back_fptr (	/* Returns FR_OK or FR_DISK_ERR */
+	FIL* fp,			/* Pointer to the file object */
+	FSIZE_t fptr,		/* File pointer to be restored */
+	DWORD clst,			/* Cluster of the file pointer */
+	DWORD sect			/* Sector of the file pointer (valid when fptr is in the middle of a sector) */
+)
+{
+	FATFS *fs = fp->obj.fs;
+
+
+	fp->fptr = fptr;
+	fp->clust = clst;
+	if (fptr % SS(fs) && fp->sect != sect) {	/* The sector cache is to hold the sector at the file pointer */
+#if !_FS_TINY
+#if !_FS_READONLY
+		if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
+			if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) return FR_DISK_ERR;
+			fp->flag &= ~FA_DIRTY;
+		}
+#endif
+#if _FS_WRITEBEHIND
+		if (wb_flush(fp) != RES_OK) return FR_DISK_ERR;	/* The sector can be in the write-behind buffer */
+#endif
+		if (disk_read(fs->drv, fp->buf, sect, 1) != RES_OK) return FR_DISK_ERR;
+#endif
+		fp->sect = sect;
+	}
+	return FR_OK;
+}
+
+
+FRESULT f_pread (
+	FIL* fp, 		/* Pointer to the file object */
+	void* buff,		/* Pointer to data buffer */
+	UINT btr,		/* Number of bytes to read */
+	FSIZE_t ofs,	/* File offset to read from */
+	UINT* br		/* Pointer to number of bytes read */
+)
+{
+	FRESULT res, rres;
+	FATFS *fs;
+	FSIZE_t fptr;
+	DWORD clst, sect;
+
+
+	*br = 0;	/* Clear read byte counter */
+	res = validate(fp, &fs);	/* Lock the volume for the whole operation */
+	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
+	if (!(fp->flag & FA_READ)) LEAVE_FF(fs, FR_DENIED); /* Check access mode */
+
+	fptr = fp->fptr; clst = fp->clust; sect = fp->sect;	/* Save the file pointer */
+	res = f_lseek(fp, ofs);		/* Follows from the current cluster or the CLMT if possible */
+	if (res == FR_OK) res = f_read(fp, buff, btr, br);
+	fp->err = 0;				/* An error of the positional access is returned but not kept in the shared file object */
+	rres = put_back_fptr(fp, fptr, clst, sect);
+	if (res == FR_OK && rres != FR_OK) ABORT(fs, rres);
+
+	LEAVE_FF(fs, res);
+}
+
+
+#if !_FS_READONLY
+FRESULT f_pwrite (
+	FIL* fp,			/* Pointer to the file object */
+	const void* buff,	/* Pointer to the data to be written */
+	UINT btw,			/* Number of bytes to write */
+	FSIZE_t ofs,		/* File offset to write at (the file is expanded if it is beyond the end) */
+	UINT* bw			/* Pointer to number of bytes written */
+)
+{
+	FRESULT res, rres;
+	FATFS *fs;
+	FSIZE_t fptr;
+	DWORD clst, sect;
+
+
+	*bw = 0;	/* Clear write byte counter */
+	res = validate(fp, &fs);	/* Lock the volume for the whole operation */
+	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
+	if (!(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);	/* Check access mode */
+
+	fptr = fp->fptr; clst = fp->clust; sect = fp->sect;	/* Save the file pointer */
+	res = f_lseek(fp, ofs);		/* Follows from the current cluster or the CLMT if possible */
+	if (res == FR_OK) res = f_write(fp, buff, btw, bw);
+	fp->err = 0;				/* An error of the positional access is returned but not kept in the shared file object */
+	rres = put_back_fptr(fp, fptr, clst, sect);
+	if (res == FR_OK && rres != FR_OK) ABORT(fs, rres);
+
+	LEAVE_FF(fs, res);
+}
+#endif
+
+#endif /* _USE_PREAD */
+
+
+
 #if _FS_MINIMIZE <= 1
 /*-----------------------------------------------------------------------*/
 /* Create a Directory Object                                             */
@@ -4223,6 +6201,43 @@ FRESULT f_readdir (
 
 
 
+
+/*-----------------------------------------------------------------------*/
+/* Read Directory Entries in Batch                                       */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_readdir_batch (
+	DIR* dp,			/* Pointer to the open directory object */
+	FILINFO* fno,		/* Pointer to the file information array to return */
+	UINT count,			/* Number of items in the array */
+	UINT* nread			/* Pointer to number of items read (<count:end of directory reached) */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	UINT n = 0;
+	DEF_NAMBUF
+
+
+	res = validate(dp, &fs);	/* Check validity of the object */
+	if (res == FR_OK) {
+		INIT_NAMBUF(fs);
+		while (n < count) {			/* Read items under a single lock */
+			res = dir_read(dp, 0);			/* Read an item */
+			if (res != FR_OK) break;
+			get_fileinfo(dp, &fno[n++]);	/* Get the object information */
+			res = dir_next(dp, 0);			/* Increment index for next */
+			if (res != FR_OK) break;
+		}
+		if (res == FR_NO_FILE) res = FR_OK;	/* End of directory is not an error */
+		FREE_NAMBUF();
+	}
+	*nread = n;
+	LEAVE_FF(fs, res);
+}
+
+
+
 #if _USE_FIND
 /*-----------------------------------------------------------------------*/
 /* Find Next File                                                        */
@@ -4323,10 +6338,7 @@ FRESULT f_getfree (
 {
 	FRESULT res;
 	FATFS *fs;
-	DWORD nfree, clst, sect, stat;
-	UINT i;
-	BYTE *p;
-	_FDID obj;
+	DWORD nfree;
 
 
 	/* Get logical drive number */
@@ -4336,56 +6348,52 @@ FRESULT f_getfree (
 		/* If free_clst is valid, return it without full cluster scan */
 		if (fs->free_clst <= fs->n_fatent - 2) {
 			*nclst = fs->free_clst;
-		} else {
+		}
+#if _FS_FREEMAP
+		else if (fs->fm_nclst) {	/* Count free clusters with the free cluster map */
+			DWORD stat;
+
+			res = fm_build(fs);
+			if (res == FR_OK) {
+				nfree = fm_count(fs);
+				if (fs->fm_nclst < fs->n_fatent) {	/* Scan the rest of FAT not covered by the map */
+					res = scan_fat(fs, fs->fm_nclst, fs->n_fatent, 0, &stat);
+					nfree += stat;
+				}
+			}
+			if (res == FR_OK) {
+				*nclst = nfree;			/* Return the free clusters */
+				fs->free_clst = nfree;	/* Now free_clst is valid */
+				fs->fsi_flag |= 1;		/* FSInfo is to be updated */
+			}
+		}
+#endif
+		else {
 			/* Get number of free clusters */
 			nfree = 0;
-			if (fs->fs_type == FS_FAT12) {	/* FAT12: Sector unalighed FAT entries */
-				clst = 2; obj.fs = fs;
-				do {
-					stat = get_fat(&obj, clst);
-					if (stat == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
-					if (stat == 1) { res = FR_INT_ERR; break; }
-					if (stat == 0) nfree++;
-				} while (++clst < fs->n_fatent);
-			} else {
 #if _FS_EXFAT
-				if (fs->fs_type == FS_EXFAT) {	/* exFAT: Scan bitmap table */
-					BYTE bm;
-					UINT b;
-
-					clst = fs->n_fatent - 2;
-					sect = fs->database;
-					i = 0;
-					do {
-						if (i == 0 && (res = move_window(fs, sect++)) != FR_OK) break;
-						for (b = 8, bm = fs->win[i]; b && clst; b--, clst--) {
-							if (!(bm & 1)) nfree++;
-							bm >>= 1;
-						}
-						i = (i + 1) % SS(fs);
-					} while (clst);
-				} else
+			if (fs->fs_type == FS_EXFAT) {	/* exFAT: Scan bitmap table */
+				DWORD clst, sect;
+				UINT i, b;
+				BYTE bm;
+
+				clst = fs->n_fatent - 2;
+				sect = fs->database;
+				i = 0;
+				do {
+					if (i == 0 && (res = move_window(fs, sect++)) != FR_OK) break;
+					for (b = 8, bm = fs->win[i]; b && clst; b--, clst--) {
+						if (!(bm & 1)) nfree++;
+						bm >>= 1;
+					}
+					i = (i + 1) % SS(fs);
+				} while (clst);
+			} else
 #endif
-				{	/* FAT16/32: Sector alighed FAT entries */
-					clst = fs->n_fatent; sect = fs->fatbase;
-					i = 0; p = 0;
-					do {
-						if (i == 0) {
-							res = move_window(fs, sect++);
-							if (res != FR_OK) break;
-							p = fs->win;
-							i = SS(fs);
-						}
-						if (fs->fs_type == FS_FAT16) {
-							if (ld_word(p) == 0) nfree++;
-							p += 2; i -= 2;
-						} else {
-							if ((ld_dword(p) & 0x0FFFFFFF) == 0) nfree++;
-							p += 4; i -= 4;
-						}
-					} while (--clst);
-				}
+			{	/* FAT12/16/32: Scan FAT (in multi-sector batches if burst buffer is available) */
+				res = scan_fat(fs, 2, fs->n_fatent, 0, &nfree);
 			}
+			if (res != FR_OK) LEAVE_FF(fs, res);
 			*nclst = nfree;			/* Return the free clusters */
 			fs->free_clst = nfree;	/* Now free_clst is valid */
 			fs->fsi_flag |= 1;		/* FSInfo is to be updated */
@@ -4398,6 +6406,89 @@ FRESULT f_getfree (
 
 
 
+#if _FS_GETFREE_NB
+/*-----------------------------------------------------------------------*/
+/* Get Number of Free Clusters without Blocking                          */
+/*-----------------------------------------------------------------------*/
+
+FRESULT f_getfree_nb (
+	const TCHAR* path,	/* Path name of the logical drive number */
+	DWORD* nclst,		/* Pointer to a variable to return number of free clusters */
+	BYTE* exact,		/* Pointer to return status of the number (0:estimate, 1:exact) */
+	FATFS** fatfs		/* Pointer to return pointer to corresponding file system object */
+)
+{
+	FRESULT res;
+	FATFS *fs;
+	DWORD clst, ecl, nfree, sc, un, r;
+	UINT sh;
+
+
+	/* Get logical drive number */
+	res = find_volume(&path, &fs, 0);
+	if (res != FR_OK) LEAVE_FF(fs, res);
+	*fatfs = fs;				/* Return ptr to the fs object */
+#if _FS_FREEMAP
+	if (fs->free_clst > fs->n_fatent - 2 && fs->fm_valid && fs->fm_nclst == fs->n_fatent) {	/* Count with the free cluster map */
+		fs->free_clst = fm_count(fs);
+		fs->fsi_flag |= 1;
+	}
+#endif
+	if (fs->free_clst <= fs->n_fatent - 2) {	/* If free_clst is valid, return it */
+		fs->gf_clst = 0;		/* Scan is no longer needed */
+		*nclst = fs->free_clst;
+		*exact = 1;
+		LEAVE_FF(fs, FR_OK);
+	}
+
+	if (_FS_EXFAT && fs->fs_type == FS_EXFAT) LEAVE_FF(fs, FR_DENIED);	/* exFAT is not supported */
+
+	/* Scan a slice of the FAT following the last call */
+	if (fs->gf_clst < 2) {		/* Start a new scan */
+		fs->gf_clst = 2; fs->gf_nfree = 0;
+	}
+	clst = fs->gf_clst;
+	ecl = clst + (DWORD)_FS_GETFREE_NB * (fs->fs_type == FS_FAT12 ? SS(fs) * 2 / 3 : SS(fs) / (fs->fs_type == FS_FAT16 ? 2 : 4));
+	if (ecl > fs->n_fatent) ecl = fs->n_fatent;
+#if _FS_FREEMAP
+	if (!fs->fm_valid && clst < fs->fm_nclst) {	/* Build the free cluster map along with the scan */
+		if (ecl > fs->fm_nclst) ecl = fs->fm_nclst;
+		res = scan_fat(fs, clst, ecl, 1, &nfree);
+		if (res == FR_OK && ecl == fs->fm_nclst) fs->fm_valid = 1;	/* Free cluster map is completed */
+	} else
+#endif
+	{
+		res = scan_fat(fs, clst, ecl, 0, &nfree);
+	}
+	if (res != FR_OK) {
+		fs->gf_clst = 0;
+		LEAVE_FF(fs, res);
+	}
+	fs->gf_nfree += nfree;
+	fs->gf_clst = ecl;
+
+	if (ecl == fs->n_fatent) {	/* Scan completed */
+		fs->free_clst = fs->gf_nfree;	/* Now free_clst is valid */
+		fs->fsi_flag |= 1;				/* FSInfo is to be updated */
+		fs->gf_clst = 0;
+		*nclst = fs->free_clst;
+		*exact = 1;
+	} else {					/* Estimate from the free ratio of the scanned area */
+		sc = ecl - 2; un = fs->n_fatent - ecl;
+		for (sh = 0; (sc >> sh) > 0xFFFFFF; sh++) ;
+		r = (fs->gf_nfree >> sh) * 256 / (sc >> sh);	/* Free ratio in unit of 1/256 */
+		*nclst = fs->gf_nfree + (un >> 8) * r + ((un & 255) * r >> 8);
+		*exact = 0;
+	}
+
+	LEAVE_FF(fs, FR_OK);
+}
+
+#endif
+
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Truncate File                                                         */
 /*-----------------------------------------------------------------------*/
@@ -4415,6 +6506,18 @@ FRESULT f_truncate (
 	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
 	if (!(fp->flag & FA_WRITE)) LEAVE_FF(fs, FR_DENIED);	/* Check access mode */
 
+#if _FS_PREALLOC
+	pa_release(fs, &fp->obj);	/* Release the preallocation window */
+#endif
+#if _FS_LINKMAP
+	if (fp->lmap) lm_release(fp, 0);	/* The chain is to be mapped again */
+#endif
+#if _FS_READAHEAD
+	fp->ra_cnt = 0;		/* Read-ahead data is no longer valid */
+#endif
+#if _FS_WRITEBEHIND
+	if (wb_flush(fp) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Write out the buffered sectors before the chain is cut */
+#endif
 	if (fp->obj.objsize > fp->fptr) {
 		if (fp->fptr == 0) {	/* When set file size to zero, remove entire cluster chain */
 			res = remove_chain(&fp->obj, fp->obj.sclust, 0);
@@ -4581,6 +6684,9 @@ FRESULT f_mkdir (
 			tm = GET_FATTIME();
 			if (res == FR_OK) {					/* Initialize the new directory table */
 				dsc = clust2sect(fs, dcl);
+#if _FS_WINCACHE
+				wc_purge(fs, dsc, fs->csize);	/* Discard stale copies of the new cluster */
+#endif
 				dir = fs->win;
 				mem_set(dir, 0, SS(fs));
 				if (!_FS_EXFAT || fs->fs_type != FS_EXFAT) {
@@ -4601,6 +6707,9 @@ FRESULT f_mkdir (
 					if (res != FR_OK) break;
 					mem_set(dir, 0, SS(fs));
 				}
+#if _FS_WINCACHE
+				fs->winsect = 0xFFFFFFFF;		/* Invalidate the cleared window so that it is not cached */
+#endif
 			}
 			if (res == FR_OK) res = dir_register(&dj);	/* Register the object to the directoy */
 			if (res == FR_OK) {
@@ -5008,6 +7117,9 @@ FRESULT f_setlabel (
 					mem_cpy(dj.dir, dirvn, 11);	/* Change the volume label */
 				} else {
 					dj.dir[DIR_Name] = DDEM;	/* Remove the volume label */
+#if _FS_DIRHINT
+					bh_update(&dj, 0);
+#endif
 				}
 			}
 			fs->wflag = 1;
@@ -5086,8 +7198,21 @@ FRESULT f_expand (
 	} else
 #endif
 	{
+#if _FS_FREEMAP
+		if (fs->fm_nclst) res = fm_build(fs);
+		if (res != FR_OK) LEAVE_FF(fs, res);
+#endif
 		scl = clst = stcl; ncl = 0;
 		for (;;) {	/* Find a contiguous cluster block */
+#if _FS_FREEMAP
+			if (clst < fs->fm_nclst) {	/* Get the cluster status from the free cluster map */
+				if (clst % 32 == 0 && fs->fmap[clst / 32] == 0xFFFFFFFF
+					&& clst + 32 <= fs->fm_nclst && clst + 32 < fs->n_fatent && stcl - clst - 1 >= 31) {
+					clst += 31;		/* Skip a word of clusters in use without passing over the start cluster */
+				}
+				n = ((fs->fmap[clst / 32] >> (clst % 32)) & 1) ? 2 : 0;
+			} else
+#endif
 			n = get_fat(&fp->obj, clst);
 			if (++clst >= fs->n_fatent) clst = 2;
 			if (n == 1) { res = FR_INT_ERR; break; }
@@ -5105,6 +7230,9 @@ FRESULT f_expand (
 					res = put_fat(fs, clst, (tcl == 1) ? 0xFFFFFFFF : clst + 1);
 					if (res != FR_OK) break;
 					lclst = clst;
+#if _FS_GETFREE_NB
+					if (clst < fs->gf_clst) fs->gf_nfree--;	/* Allocated in the area already counted */
+#endif
 				}
 			} else {
 				lclst = scl - 1;
@@ -5132,11 +7260,12 @@ FRESULT f_expand (
 /* Forward data to the stream directly                                   */
 /*-----------------------------------------------------------------------*/
 
-FRESULT f_forward (
-	FIL* fp, 						/* Pointer to the file object */
-	UINT (*func)(const BYTE*,UINT),	/* Pointer to the streaming function */
-	UINT btf,						/* Number of bytes to forward */
-	UINT* bf						/* Pointer to number of bytes forwarded */
+FRESULT f_forward_ctx (
+	FIL* fp, 								/* Pointer to the file object */
+	UINT (*func)(void*,const BYTE*,UINT),	/* Pointer to the streaming function */
+	void* ctx,								/* Context pointer passed to the streaming function */
+	UINT btf,								/* Number of bytes to forward */
+	UINT* bf								/* Pointer to number of bytes forwarded */
 )
 {
 	FRESULT res;
@@ -5151,11 +7280,14 @@ FRESULT f_forward (
 	res = validate(fp, &fs);		/* Check validity of the object */
 	if (res != FR_OK || (res = (FRESULT)fp->err) != FR_OK) LEAVE_FF(fs, res);	/* Check validity */
 	if (!(fp->flag & FA_READ)) LEAVE_FF(fs, FR_DENIED);	/* Check access mode */
+#if _FS_WRITEBEHIND
+	if (wb_flush(fp) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Buffered sectors are to be read from the disk */
+#endif
 
 	remain = fp->obj.objsize - fp->fptr;
 	if (btf > remain) btf = (UINT)remain;			/* Truncate btf by remaining bytes */
 
-	for ( ;  btf && (*func)(0, 0);					/* Repeat until all data transferred or stream goes busy */
+	for ( ;  btf && (*func)(ctx, 0, 0);				/* Repeat until all data transferred or stream goes busy */
 		fp->fptr += rcnt, *bf += rcnt, btf -= rcnt) {
 		csect = (UINT)(fp->fptr / SS(fs) & (fs->csize - 1));	/* Sector offset in the cluster */
 		if (fp->fptr % SS(fs) == 0) {				/* On the sector boundary? */
@@ -5173,27 +7305,79 @@ FRESULT f_forward (
 #if _FS_TINY
 		if (move_window(fs, sect) != FR_OK) ABORT(fs, FR_DISK_ERR);	/* Move sector window to the file data */
 		dbuf = fs->win;
+		rcnt = SS(fs);
 #else
-		if (fp->sect != sect) {		/* Fill sector cache with file data */
+#if _FS_READAHEAD
+		if (fp->rabuf) {							/* Forward the data in the read-ahead buffer in place */
+			if (sect - fp->ra_sect >= fp->ra_cnt) {	/* Not in the buffer? */
 #if !_FS_READONLY
-			if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
-				if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
-				fp->flag &= ~FA_DIRTY;
+				if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
+					if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+					fp->flag &= ~FA_DIRTY;
+				}
+#endif
+				if (ra_read(fp, sect) != RES_OK) ABORT(fs, FR_DISK_ERR);	/* Load the following sectors */
+				fp->sect = sect;
 			}
+			dbuf = fp->rabuf + (sect - fp->ra_sect) * SS(fs);
+			rcnt = (fp->ra_sect + fp->ra_cnt - sect) * SS(fs);	/* Up to the end of the buffered sectors */
+		} else
+#endif
+		{
+			if (fp->sect != sect) {		/* Fill sector cache with file data */
+#if !_FS_READONLY
+				if (fp->flag & FA_DIRTY) {		/* Write-back dirty sector cache */
+					if (disk_write(fs->drv, fp->buf, fp->sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+					fp->flag &= ~FA_DIRTY;
+				}
 #endif
-			if (disk_read(fs->drv, fp->buf, sect, 1) != RES_OK) ABORT(fs, FR_DISK_ERR);
+				if (RA_READ(fp, sect) != RES_OK) ABORT(fs, FR_DISK_ERR);
+			}
+			fp->sect = sect;
+			dbuf = fp->buf;
+			rcnt = SS(fs);
 		}
-		dbuf = fp->buf;
 #endif
-		fp->sect = sect;
-		rcnt = SS(fs) - (UINT)fp->fptr % SS(fs);	/* Number of bytes left in the sector */
-		if (rcnt > btf) rcnt = btf;					/* Clip it by btr if needed */
-		rcnt = (*func)(dbuf + ((UINT)fp->fptr % SS(fs)), rcnt);	/* Forward the file data */
+		rcnt -= (UINT)fp->fptr % SS(fs);			/* Number of bytes left in the span */
+		if (rcnt > btf) rcnt = btf;					/* Clip it by btf if needed */
+		rcnt = (*func)(ctx, dbuf + ((UINT)fp->fptr % SS(fs)), rcnt);	/* Forward the file data (may be accepted in part) */
 		if (!rcnt) ABORT(fs, FR_INT_ERR);
+		fp->clust += (DWORD)((fp->fptr % ((DWORD)fs->csize * SS(fs)) + rcnt - 1) / ((DWORD)fs->csize * SS(fs)));	/* Cluster of the last byte (the span is physically contiguous) */
 	}
+#if _FS_READAHEAD
+	if (fp->rabuf && fp->fptr % SS(fs)) {		/* Stopped in the middle of a sector forwarded from the read-ahead buffer? */
+		sect = clust2sect(fs, fp->clust) + (DWORD)(fp->fptr / SS(fs) & (fs->csize - 1));
+		if (sect != fp->sect && sect - fp->ra_sect < fp->ra_cnt) {
+			mem_cpy(fp->buf, fp->rabuf + (sect - fp->ra_sect) * SS(fs), SS(fs));	/* Put it in the sector cache */
+			fp->sect = sect;
+		}
+	}
+#endif
 
 	LEAVE_FF(fs, FR_OK);
 }
+
+
+static
+UINT fw_plain (		/* Calls a streaming function without context for f_forward() */
+	void* ctx,			/* Pointer to the streaming function pointer */
+	const BYTE* buf,	/* Pointer to the data (null:sense call) */
+	UINT btf			/* Number of bytes */
+)
+{
+	return (**(UINT(**)(const BYTE*,UINT))ctx)(buf, btf);
+}
+
+
+FRESULT f_forward (
+	FIL* fp, 						/* Pointer to the file object */
+	UINT (*func)(const BYTE*,UINT),	/* Pointer to the streaming function */
+	UINT btf,						/* Number of bytes to forward */
+	UINT* bf						/* Pointer to number of bytes forwarded */
+)
+{
+	return f_forward_ctx(fp, fw_plain, &func, btf, bf);
+}
 #endif /* _USE_FORWARD */
 
 
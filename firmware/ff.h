@@ -87,6 +87,30 @@ typedef DWORD FSIZE_t;
 
 
 
+/* Sector cache slot structure (WCSLOT) */
+
+typedef struct {
+	DWORD	sect;			/* Sector number held in the slot (0xFFFFFFFF:empty) */
+	DWORD	stamp;			/* Time stamp of the last use (0:empty) */
+	BYTE	flag;			/* Slot status flags (b0:dirty) */
+	BYTE	buf[_MAX_SS];	/* Sector data */
+} WCSLOT;
+
+
+
+/* Path resolution cache item structure (PCSLOT) */
+
+typedef struct {
+	DWORD	stamp;			/* Time stamp of the last use (0:empty) */
+	DWORD	pscl;			/* Start cluster of the parent directory (0:root) */
+	DWORD	ofs;			/* Offset of the entry in the parent directory (0xFFFFFFFF:object not exist) */
+	DWORD	scl;			/* Start cluster of the object */
+	BYTE	attr;			/* Object attribute */
+	BYTE	fn[11];			/* SFN of the object {body[8],ext[3]} */
+} PCSLOT;
+
+
+
 /* File system object structure (FATFS) */
 
 typedef struct {
@@ -129,6 +153,72 @@ typedef struct {
 	DWORD	dirbase;		/* Root directory base sector/cluster */
 	DWORD	database;		/* Data base sector */
 	DWORD	winsect;		/* Current sector appearing in the win[] */
+#if _FS_WINCACHE
+	WCSLOT*	wcache;			/* Sector cache slots behind the win[], FAT cache followed by directory cache (NULL:no cache) */
+	UINT	n_fatc;			/* Number of FAT cache slots */
+	UINT	n_dirc;			/* Number of directory cache slots */
+	DWORD	wcstamp;		/* Sector cache access counter */
+	DWORD	fc_hit;			/* FAT cache hit count */
+	DWORD	fc_miss;		/* FAT cache miss count */
+	DWORD	dc_hit;			/* Directory cache hit count */
+	DWORD	dc_miss;		/* Directory cache miss count */
+	DWORD	fc_next;		/* FAT sector following the last FAT cache miss (read-ahead trigger) */
+#endif
+#if _FS_LAZYMIRROR
+	BYTE	mshift;			/* Size of a granule of the FAT mirror dirty map [log2(sectors)] */
+	BYTE	mdirty[_FS_LAZYMIRROR];	/* FAT mirror dirty map (1 bit per granule) */
+#endif
+#if _FS_BURSTBUF
+	BYTE*	bbuf;			/* Burst buffer for multi-sector metadata transfers (NULL:not available) */
+	UINT	n_bbuf;			/* Size of the burst buffer [sectors] */
+#endif
+#if _FS_GETFREE_NB
+	DWORD	gf_clst;		/* Next cluster to be counted by f_getfree_nb() (0:no count in progress) */
+	DWORD	gf_nfree;		/* Free clusters counted so far by f_getfree_nb() */
+#endif
+#if _FS_LINKMAP
+	DWORD	lmscl[_FS_LINKMAP];	/* Top cluster of the chain mapped in the library-managed cluster link map (0:free slot) */
+	BYTE	lmref[_FS_LINKMAP];	/* The map has been referenced since the last search for a slot */
+	DWORD	lmtbl[_FS_LINKMAP][_FS_LINKMAP_SIZE];	/* Library-managed cluster link map tables */
+#endif
+#if _FS_PREALLOC
+	DWORD	pa_stamp;		/* Cluster allocation counter */
+	WORD	pa_id[_FS_PREALLOC_FILES];	/* Mount ID of the owner object */
+	DWORD	pa_ocl[_FS_PREALLOC_FILES];	/* Top cluster of the chain of the owner object */
+	DWORD	pa_use[_FS_PREALLOC_FILES];	/* Allocation counter at the last use of the window (0:free slot) */
+	DWORD	pa_scl[_FS_PREALLOC_FILES];	/* Top cluster of the preallocation window */
+	DWORD	pa_ecl[_FS_PREALLOC_FILES];	/* End cluster of the preallocation window (not included) */
+#endif
+#if _FS_TAILCACHE
+	DWORD	tc_scl[_FS_TAILCACHE];	/* Top cluster of the cached chain (0:free slot) */
+	DWORD	tc_idx[_FS_TAILCACHE];	/* Index of the cached cluster in the chain */
+	DWORD	tc_clst[_FS_TAILCACHE];	/* Cached cluster (the last one accessed before close) */
+	BYTE	tc_next;				/* Slot to be replaced next */
+#endif
+#if _FS_DIRINDEX
+	BYTE*	ixbuf;			/* Directory name index area (NULL:not available) */
+	UINT	ix_size;		/* Size of the index of a directory [entries] */
+	DWORD	ix_stamp;		/* Directory index access counter */
+	DWORD	ix_scl[_FS_DIRINDEX];	/* Start cluster of the indexed directory */
+	DWORD	ix_use[_FS_DIRINDEX];	/* Time stamp of the last use of the index */
+	UINT	ix_cnt[_FS_DIRINDEX];	/* Number of entries indexed */
+	BYTE	ix_stat[_FS_DIRINDEX];	/* Index status (b0:in use, b1:no object out of the index) */
+#endif
+#if _FS_DIRHINT
+	DWORD	bh_scl[_FS_DIRHINT];	/* Start cluster of the directory */
+	UINT	bh_ofs[_FS_DIRHINT];	/* First entry that can be blank, entries in front of it are in use (0:free slot) */
+	BYTE	bh_next;				/* Slot to be replaced next */
+#endif
+#if _FS_PATHCACHE
+	DWORD	pcstamp;		/* Path resolution cache access counter */
+	PCSLOT	pcache[_FS_PATHCACHE];	/* Path resolution cache items */
+#endif
+#if _FS_FREEMAP
+	DWORD*	fmap;			/* Free cluster map (1 bit per cluster, 1:in use) (NULL:not available) */
+	UINT	fm_size;		/* Size of the free cluster map [words] */
+	DWORD	fm_nclst;		/* Number of clusters covered by the free cluster map */
+	BYTE	fm_valid;		/* Free cluster map has been built (0:not built, 1:valid) */
+#endif
 	BYTE	win[_MAX_SS];	/* Disk access window for Directory, FAT (and file data at tiny cfg) */
 } FATFS;
 
@@ -172,6 +262,24 @@ typedef struct {
 #if _USE_FASTSEEK
 	DWORD*	cltbl;			/* Pointer to the cluster link map table (nulled on open, set by application) */
 #endif
+#if _FS_LINKMAP
+	BYTE	lmap;			/* Library-managed cluster link map (0:not built, 1:in use, 2:not applicable) */
+#endif
+#if _FS_READAHEAD
+	BYTE*	rabuf;			/* Pointer to the read-ahead buffer (nulled on open, set by application) */
+	UINT	ra_size;		/* Size of the read-ahead buffer [sectors] */
+	UINT	ra_win;			/* Current read-ahead size [sectors] */
+	UINT	ra_cnt;			/* Number of sectors held in the read-ahead buffer (0:empty) */
+	DWORD	ra_sect;		/* Top sector number held in the read-ahead buffer */
+#endif
+#if _FS_WRITEBEHIND
+	BYTE*	wbbuf;			/* Pointer to the write-behind buffer (nulled on open, set by application) */
+	UINT	wb_size;		/* Size of the write-behind buffer [sectors] */
+	UINT	wb_cnt;			/* Number of sectors held in the write-behind buffer (0:empty) */
+	DWORD	wb_sect;		/* Top sector number held in the write-behind buffer */
+	DWORD	wb_age;			/* Maximum age of the buffered data [ms] (0:no limit) */
+	DWORD	wb_tick;		/* Tick count when the first sector was buffered */
+#endif
 #if !_FS_TINY
 	BYTE	buf[_MAX_SS];	/* File private data read/write window */
 #endif
@@ -215,6 +323,15 @@ typedef struct {
 
 
 
+/* Data buffer item for vectored read/write (FIOVEC) */
+
+typedef struct {
+	void*	buf;			/* Pointer to the data buffer */
+	UINT	len;			/* Number of bytes in the buffer */
+} FIOVEC;
+
+
+
 /* File function return code (FRESULT) */
 
 typedef enum {
@@ -249,12 +366,17 @@ FRESULT f_open (FIL* fp, const TCHAR* path, BYTE mode);				/* Open or create a f
 FRESULT f_close (FIL* fp);											/* Close an open file object */
 FRESULT f_read (FIL* fp, void* buff, UINT btr, UINT* br);			/* Read data from the file */
 FRESULT f_write (FIL* fp, const void* buff, UINT btw, UINT* bw);	/* Write data to the file */
+FRESULT f_readv (FIL* fp, const FIOVEC* iov, UINT iovcnt, UINT* br);	/* Read data from the file into multiple buffers */
+FRESULT f_writev (FIL* fp, const FIOVEC* iov, UINT iovcnt, UINT* bw);	/* Write data in multiple buffers to the file */
 FRESULT f_lseek (FIL* fp, FSIZE_t ofs);								/* Move file pointer of the file object */
+FRESULT f_pread (FIL* fp, void* buff, UINT btr, FSIZE_t ofs, UINT* br);			/* Read data from the file at a position */
+FRESULT f_pwrite (FIL* fp, const void* buff, UINT btw, FSIZE_t ofs, UINT* bw);	/* Write data to the file at a position */
 FRESULT f_truncate (FIL* fp);										/* Truncate the file */
 FRESULT f_sync (FIL* fp);											/* Flush cached data of the writing file */
 FRESULT f_opendir (DIR* dp, const TCHAR* path);						/* Open a directory */
 FRESULT f_closedir (DIR* dp);										/* Close an open directory */
 FRESULT f_readdir (DIR* dp, FILINFO* fno);							/* Read a directory item */
+FRESULT f_readdir_batch (DIR* dp, FILINFO* fno, UINT count, UINT* nread);	/* Read directory items into an array */
 FRESULT f_findfirst (DIR* dp, FILINFO* fno, const TCHAR* path, const TCHAR* pattern);	/* Find first file */
 FRESULT f_findnext (DIR* dp, FILINFO* fno);							/* Find next file */
 FRESULT f_mkdir (const TCHAR* path);								/* Create a sub directory */
@@ -267,11 +389,20 @@ FRESULT f_chdir (const TCHAR* path);								/* Change current directory */
 FRESULT f_chdrive (const TCHAR* path);								/* Change current drive */
 FRESULT f_getcwd (TCHAR* buff, UINT len);							/* Get current directory */
 FRESULT f_getfree (const TCHAR* path, DWORD* nclst, FATFS** fatfs);	/* Get number of free clusters on the drive */
+FRESULT f_getfree_nb (const TCHAR* path, DWORD* nclst, BYTE* exact, FATFS** fatfs);	/* Get number of free clusters in bounded steps */
 FRESULT f_getlabel (const TCHAR* path, TCHAR* label, DWORD* vsn);	/* Get volume label */
 FRESULT f_setlabel (const TCHAR* label);							/* Set volume label */
 FRESULT f_forward (FIL* fp, UINT(*func)(const BYTE*,UINT), UINT btf, UINT* bf);	/* Forward data to the stream */
+FRESULT f_forward_ctx (FIL* fp, UINT(*func)(void*,const BYTE*,UINT), void* ctx, UINT btf, UINT* bf);	/* Forward data to the stream with a context */
 FRESULT f_expand (FIL* fp, FSIZE_t szf, BYTE opt);					/* Allocate a contiguous block to the file */
 FRESULT f_mount (FATFS* fs, const TCHAR* path, BYTE opt);			/* Mount/Unmount a logical drive */
+FRESULT f_setcache (FATFS* fs, WCSLOT* slot, UINT nfat, UINT ndir);	/* Register FAT/directory cache to the file system object */
+FRESULT f_setburst (FATFS* fs, void* buf, UINT nsect);				/* Register burst buffer to the file system object */
+FRESULT f_setfreemap (const TCHAR* path, DWORD* map, UINT nwords);	/* Register free cluster map to the volume */
+FRESULT f_setdirindex (const TCHAR* path, void* buf, UINT size);		/* Register directory name index area to the volume */
+FRESULT f_setbuf (FIL* fp, void* buf, UINT nsect);					/* Register read-ahead buffer to the file object */
+FRESULT f_setwbuf (FIL* fp, void* buf, UINT nsect, DWORD maxage);	/* Register write-behind buffer to the file object */
+FRESULT f_wbpoll (FIL* fp);											/* Write out aged data in the write-behind buffer */
 FRESULT f_mkfs (const TCHAR* path, BYTE opt, DWORD au, void* work, UINT len);	/* Create a FAT volume */
 FRESULT f_fdisk (BYTE pdrv, const DWORD* szt, void* work);			/* Divide a physical drive into some partitions */
 int f_putc (TCHAR c, FIL* fp);										/* Put a character to the file */
@@ -301,6 +432,11 @@ TCHAR* f_gets (TCHAR* buff, int len, FIL* fp);						/* Get a string from the fil
 DWORD get_fattime (void);
 #endif
 
+/* Tick function */
+#if _FS_WRITEBEHIND
+DWORD ff_tick (void);	/* Millisecond counter for the write-behind age limit */
+#endif
+
 /* Unicode support functions */
 #if _USE_LFN != 0						/* Unicode - OEM code conversion */
 WCHAR ff_convert (WCHAR chr, UINT dir);	/* OEM-Unicode bidirectional conversion */
@@ -47,6 +47,48 @@
 /* This option switches fast seek function. (0:Disable or 1:Enable) */
 
 
+#define	_FS_COALESCE	128
+/* This option defines the maximum number of sectors of a direct data transfer
+/  which is extended over physically contiguous clusters. (0:Disable or >0:Enable)
+/  When disabled, f_read() and f_write() clip direct multi-sector transfers at
+/  each cluster boundary. When enabled, f_read() checks the following clusters on
+/  the FAT (or CLMT) and f_write() stretches the chain up front, and they are
+/  merged into a single multi-sector disk_read()/disk_write() while they are
+/  physically contiguous. */
+
+
+#define	_FS_LINKMAP			0
+#define	_FS_LINKMAP_SIZE	64
+/* _FS_LINKMAP switches the library-managed cluster link map. (0:Disable or >0:Enable)
+/  When enabled, f_lseek() going back to a former cluster of a file without an
+/  application supplied CLMT builds a CLMT for the file in a table of the file
+/  system object and f_read(), f_write() and the following f_lseek() use the fast
+/  seek transparently. A map is keyed by the top cluster of the chain, so it is
+/  shared by the file objects of the same file. It is extended as f_write()
+/  stretches the chain and is released on f_close() or when the chain is cut. A
+/  map which is not referenced while all slots are in use is taken over by the
+/  next file to be mapped, so that a file object dropped without f_close() does
+/  not hold the slot.
+/  A CLMT given by the application in fp->cltbl takes precedence and is left as
+/  is. f_lseek(fp, CREATE_LINKMAP) without such table fails with
+/  FR_INVALID_PARAMETER.
+/  _FS_LINKMAP defines number of files that can be mapped at a time and
+/  _FS_LINKMAP_SIZE defines size of each table in unit of DWORD, which maps up to
+/  (_FS_LINKMAP_SIZE - 2) / 2 fragments. A file which has more fragments is
+/  accessed with normal seek. _USE_FASTSEEK needs to be 1 to enable this option. */
+
+
+#define	_USE_PREAD		1
+/* This option switches positional read/write functions, f_pread() and f_pwrite().
+/  (0:Disable or 1:Enable) They read or write at a given offset under a single
+/  lock of the volume and leave the file pointer as it was, so that threads can
+/  share an open file. An error of the positional access is returned to the
+/  caller and does not stay in the file object, unless the file pointer could
+/  not be restored. When _FS_REENTRANT is 1, the sync object needs to allow
+/  nested locking by the owner thread (the recursive mutex in FatFs.cpp does).
+/  Also _FS_MINIMIZE needs to be 0, 1 or 2 to enable this option. */
+
+
 #define	_USE_EXPAND		1
 /* This option switches f_expand function. (0:Disable or 1:Enable) */
 
@@ -62,7 +104,10 @@
 
 
 #define	_USE_FORWARD	1
-/* This option switches f_forward() function. (0:Disable or 1:Enable) */
+/* This option switches f_forward() and f_forward_ctx() function. (0:Disable or 1:Enable)
+/  f_forward_ctx() passes a context pointer to the streaming function, and when a
+/  read-ahead buffer is registered to the file, it forwards the data in spans of
+/  the buffered sectors instead of a sector at a time. */
 
 
 /*---------------------------------------------------------------------------/
@@ -209,6 +254,164 @@
 /  buffer in the file system object (FATFS) is used for the file data transfer. */
 
 
+#define	_FS_WINCACHE	1
+#define	_FS_FATCACHE	4
+#define	_FS_DIRCACHE	2
+/* The _FS_WINCACHE switches the sector cache behind the disk access window of
+/  the file system object. (0:Disable or 1:Enable) When enabled, sectors that
+/  leave the window are kept in an array of WCSLOT items and replaced in least
+/  recently used order. FAT sectors and directory/FSINFO sectors are held in
+/  separate pools, so a directory scan does not evict the FAT sectors needed by
+/  the allocator and vice versa. Dirty slots are written back when they are
+/  evicted and when the volume is synchronized. The cache is registered to the
+/  file system object with f_setcache() before it is mounted, and hit/miss counts
+/  of each pool are kept in the file system object.
+/
+/  _FS_FATCACHE and _FS_DIRCACHE define default number of slots of the FAT cache
+/  and directory cache allocated by FatFs::attach(). Each slot occupies about
+/  _MAX_SS + 12 bytes. _FS_WINCACHE must be 0 at tiny buffer or read-only
+/  configuration. */
+
+
+#define	_FS_FATREADAHEAD	4
+/* This option defines maximum number of FAT sectors read ahead when the FAT is
+/  being accessed in sequential order, such as following a long cluster chain.
+/  (0:Disable or >0:Enable) On a FAT cache miss at the sector that follows the
+/  previous miss, the sector and the following ones are read with a single
+/  multi-sector disk_read() into the burst buffer and put into the FAT cache.
+/  The number of sectors is also limited by the burst buffer and FAT cache size.
+/  This option has no effect when _FS_WINCACHE or _FS_BURSTBUF is 0. */
+
+
+#define	_FS_LAZYMIRROR	64
+/* This option defers the writes to the second FAT copy. (0:Disable or >0:Enable)
+/  When enabled, changes of the first FAT are tracked in a dirty map kept in the
+/  file system object and reflected to the other FAT copies in ascending,
+/  coalesced multi-sector runs when the volume is synchronized (f_sync(),
+/  f_close() and other functions that change the volume) and when it is
+/  unmounted. The value defines size of the dirty map in bytes. Each bit of the
+/  map covers a power of 2 number of FAT sectors. This option must be 0 at
+/  read-only configuration. */
+
+
+#define	_FS_BURSTBUF	8
+/* This option switches the burst buffer for multi-sector metadata transfers.
+/  (0:Disable or >0:Enable) When a burst buffer is registered to the file system
+/  object with f_setburst() before it is mounted, FAT mirror updates and other
+/  metadata transfers are issued as multi-sector disk_read()/disk_write() calls
+/  of up to the buffer size, and f_getfree() scans the FAT in the batches of the
+/  buffer size. The buffer must be aligned to DWORD. The value defines default
+/  size of the burst buffer allocated by FatFs::attach() in unit of sector. */
+
+
+#define	_FS_FREEMAP	4096
+/* This option switches the in-memory free cluster map. (0:Disable or >0:Enable)
+/  When a map is registered to the volume with f_setfreemap(), allocation status
+/  of the clusters is kept in the map (1 bit per cluster), built by a scan of the
+/  FAT on the first need. Free cluster search in cluster allocation, f_expand()
+/  and counting in f_getfree() are done in the memory without FAT reads. The value
+/  defines the maximum size of the map allocated by FatFs::attach() in unit of
+/  byte. Clusters beyond the map are handled with FAT access as usual. This option
+/  must be 0 at read-only configuration. */
+
+
+#define	_FS_PREALLOC	16
+#define	_FS_PREALLOC_FILES	4
+/* _FS_PREALLOC switches the per-file preallocation window. (0:Disable or >0:Enable)
+/  When a file is extended by f_write(), this number of clusters following the
+/  last allocated one is reserved for the file until it is closed or truncated,
+/  so that files appended concurrently get contiguous cluster chains instead of
+/  interleaved ones. Reservation is kept in memory only and nothing is written to
+/  the volume. _FS_PREALLOC_FILES defines number of files that can hold a window
+/  at a time. Other files grow without a window when all slots are in use. A
+/  window is tied to the top cluster of the file, and it is given to another file
+/  when its file has not been stretched while _FS_PREALLOC * _FS_PREALLOC_FILES
+/  clusters were allocated, so that a file object abandoned without f_close()
+/  does not hold its slot forever. */
+
+
+#define	_FS_TAILCACHE	8
+/* This option switches the tail cluster cache. (0:Disable or >0:Enable)
+/  When a file is closed, the cluster at its file pointer (the last cluster after
+/  appending) is kept with its index in the chain. f_open() with FA_OPEN_APPEND
+/  and f_lseek() to a back cluster follow the chain from the cached cluster
+/  instead of the top of the chain, so that reopening a large file for append
+/  does not walk the whole chain. The value defines number of files cached. The
+/  cache is cleared when any cluster chain is removed. */
+
+
+#define	_FS_DIRINDEX		0
+#define	_FS_DIRINDEX_SIZE	4096
+/* _FS_DIRINDEX switches the directory name index. (0:Disable or >0:Enable)
+/  When an index area is registered to the volume with f_setdirindex(), a 1-byte
+/  hash of the name of each entry is kept for the recently searched directories,
+/  so that finding an object reads only the entries whose hash matches instead of
+/  all entries in front of it. The index of a directory is built while it is
+/  scanned and updated as entries are created or removed. _FS_DIRINDEX defines
+/  number of directories indexed at a time and _FS_DIRINDEX_SIZE defines default
+/  size of the index area allocated by FatFs::attach() in bytes, which is divided
+/  among the directories at 1 byte per entry. Entries out of the index are
+/  searched linearly. This option is available only at non-LFN configuration.
+/  It is disabled by default because the index area costs _FS_DIRINDEX_SIZE bytes
+/  of RAM per attached drive, and a path deeper than _FS_DIRINDEX levels evicts
+/  the indexed directories while it is followed. */
+
+
+#define	_FS_DIRHINT		8
+/* This option switches the blank entry hint. (0:Disable or >0:Enable)
+/  The first entry that can be blank is kept for the directories where objects
+/  were created recently. Every entry in front of it is known to be in use, so
+/  that creating an object searches blank entries from there instead of the top
+/  of the directory. The hint moves forward as the entry is filled and back when
+/  an entry in front of it is removed. The value defines number of directories
+/  tracked at a time. This option is available only at non-LFN configuration. */
+
+
+#define	_FS_PATHCACHE	16
+/* This option switches the path resolution cache. (0:Disable or >0:Enable)
+/  When enabled, results of the directory searches made while following a path
+/  name are kept in the file system object, keyed by the parent directory and the
+/  segment name, including the names that were not found. Sub-directories in the
+/  middle of a path are entered without reading the directory, and the last
+/  segment is checked at its cached location. The cache is kept coherent as
+/  objects are created, removed and renamed. The value defines number of items
+/  cached. This option is available only at non-LFN configuration. */
+
+
+#define	_FS_GETFREE_NB	16
+/* This option switches f_getfree_nb() function. (0:Disable or >0:Enable)
+/  f_getfree_nb() counts free clusters in bounded steps instead of scanning the
+/  whole FAT in a call. Each call scans this number of FAT sectors following the
+/  previous call and returns an estimate from the area scanned so far, until the
+/  scan is completed and the exact number is available. The volume is locked only
+/  during each step. Also _FS_READONLY needs to be 0 and _FS_MINIMIZE needs to
+/  be 0 to enable this option. exFAT volumes are not supported. */
+
+
+#define	_FS_READAHEAD	1
+/* This option switches f_setbuf() function. (0:Disable or 1:Enable)
+/  A read-ahead buffer can be registered to a file object with f_setbuf(). When
+/  the sector cache of the file is filled, following sectors in the physically
+/  contiguous area of the file are read into the buffer with a multiple sector
+/  read. The read size starts at a sector and doubles on each sequential refill
+/  up to the size of the buffer, and it is reset to a sector on a random access,
+/  so small reads in sequence, such as f_gets(), cost one disk access per buffer
+/  instead of per sector. Also _FS_TINY needs to be 0 to enable this option. */
+
+
+#define	_FS_WRITEBEHIND	1
+/* This option switches f_setwbuf() function. (0:Disable or 1:Enable)
+/  A write-behind buffer can be registered to a file object with f_setwbuf().
+/  Sectors completed by f_write() are held in the buffer while they continue in
+/  a physically contiguous area and are written with a multiple sector write when
+/  the buffer gets full, the sequence breaks, or at f_sync(), f_close(), f_read(),
+/  f_lseek() and f_truncate(). A maximum age of the buffered data can be given in
+/  milliseconds. It is checked at the end of each f_write() and by f_wbpoll(),
+/  which needs to be called periodically to bound the age while the file is not
+/  written. A tick function, ff_tick(), needs to be added to the project. Also
+/  _FS_READONLY and _FS_TINY need to be 0 to enable this option. */
+
+
 #define _FS_EXFAT	0
 /* This option switches support of exFAT file system in addition to the traditional
 /  FAT file system. (0:Disable or 1:Enable) To enable exFAT, also LFN must be enabled.
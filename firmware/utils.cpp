@@ -27,55 +27,118 @@ FRESULT print_file_info(const char* path, Print& print) {
     return result;
 }
 
-//Recursive directory list, adapted from FatFs documentation (http://elm-chan.org/fsw/ff/en/readdir.html)
-FRESULT scan_files (String path, Print& print)
+FRESULT FileWalker::walk(const char* root, Callback callback, void* context, uint8_t order)
 {
-    return scan_files(path, [&print](String& filePath, FILINFO& fno) -> bool
-	{
-		print_file_info(filePath, print);
-		return true;
-	});
-}
+    size_t length = strlen(root);
+    if (length > 0 && (root[length - 1] == '/' || root[length - 1] == '\\'))
+        length--;                                           /* Separator is added per entry */
+    if (length >= sizeof(_path))
+        return FR_INVALID_NAME;
+    memcpy(_path, root, length);
+    _path[length] = 0;
+
+    FRESULT res = f_opendir(&_dirs[0], root);
+    if (res != FR_OK)
+        return res;
+    _length[0] = length;
+    int depth = 1;
+    bool skip = false;
+
+    while (depth > 0) {
+        if (!skip) {
+            res = f_readdir(&_dirs[depth - 1], &_entry);    /* Read an item of the innermost directory */
+            if (res != FR_OK) {
+                if (depth == 1)
+                    break;
+                LOG(ERROR, "%s: %s", _path, FatFs::fileResultMessage(res));
+                res = FR_OK;                                /* Leave the rest of the sub-directory */
+                skip = true;
+            }
+        }
 
-FRESULT scan_files(String path, std::function<bool(String&, FILINFO&)> cb)
-{
-    FRESULT res;
-    DIR dir;
-    static FILINFO fno;
-
-    res = f_opendir(&dir, path);                            /* Open the directory */
-    if (res == FR_OK) {
-        for (;;) {
-            res = f_readdir(&dir, &fno);                    /* Read a directory item */
-            if (res != FR_OK || fno.fname[0] == 0) break;   /* Break on error or end of dir */
-            String nextPath = path + "/" + fno.fname;
-            bool result = cb(nextPath, fno);
-            if (fno.fattrib & AM_DIR) {                     /* It is a directory */
-            	if(result)
-            	{
-					res = scan_files(nextPath, cb);          /* Enter the directory */
-					if (!(res == FR_OK || FR_INVALID_NAME)) break;
-            	}
-            } else if(!result)
-            	break;
+        if (skip || _entry.fname[0] == 0) {                 /* End of the directory, go back to the parent */
+            skip = false;
+            f_closedir(&_dirs[--depth]);
+            _path[_length[depth]] = 0;
+            if (depth > 0 && (order & POST_ORDER)
+                    && callback(context, _path, _info[depth], true) == STOP)
+                break;
+            if (depth > 0)
+                _path[_length[depth - 1]] = 0;
+            continue;
+        }
+
+        size_t base = _length[depth - 1];
+        size_t nameLength = strlen(_entry.fname);
+        if (base + 1 + nameLength >= sizeof(_path)) {
+            LOG(ERROR, "%s/%s: path is too long", _path, _entry.fname);
+            continue;
+        }
+        _path[base] = '/';
+        memcpy(_path + base + 1, _entry.fname, nameLength + 1);
+
+        bool isDir = _entry.fattrib & AM_DIR;
+        Action action = CONTINUE;
+        if (!isDir || (order & PRE_ORDER))
+            action = callback(context, _path, _entry, false);
+        if (action == STOP)
+            break;
+        if (action == SKIP_SIBLINGS) {
+            _path[base] = 0;
+            skip = true;
+            continue;
+        }
+
+        if (isDir && action != PRUNE) {                     /* Enter the directory */
+            if (depth == FILE_WALKER_MAX_DEPTH)
+                res = FR_NOT_ENOUGH_CORE;
+            else
+                res = f_opendir(&_dirs[depth], _path);
+            if (res != FR_OK) {
+                LOG(ERROR, "%s: %s", _path, FatFs::fileResultMessage(res));
+                res = FR_OK;                                /* Skip the directory */
+                _path[base] = 0;
+                continue;
+            }
+            _info[depth] = _entry;
+            _length[depth] = base + 1 + nameLength;
+            depth++;
+        } else {
+            _path[base] = 0;
         }
-        f_closedir(&dir);
     }
 
+    while (depth > 0)                                       /* Close the directories left open on stop or error */
+        f_closedir(&_dirs[--depth]);
     return res;
 }
 
-FRESULT f_getfree_out(uint8_t driveNumber, uint64_t* bytesFreeOut, uint64_t* bytesUsedOut, uint64_t* bytesTotalOut) {
-    FATFS *fs;
-    DWORD fre_clust, fre_sect, tot_sect;
+//Directory list, printed by an iterative walk of the tree
+FRESULT scan_files (String path, Print& print)
+{
+    FileWalker walker;
+    return walker.walk(path.c_str(), [&print](const char* filePath, const FILINFO& fno, bool) -> FileWalker::Action
+    {
+        print_file_info(filePath, fno, print);
+        return FileWalker::CONTINUE;
+    });
+}
 
-    char path[3];
-    path[0] = '0' + driveNumber;
-    path[1] = ':';
-    path[2] = 0;
+FRESULT scan_files(String path, std::function<bool(String&, FILINFO&)> cb)
+{
+    FileWalker walker;
+    return walker.walk(path.c_str(), [&cb](const char* filePath, const FILINFO& fno, bool) -> FileWalker::Action
+    {
+        String nextPath(filePath);
+        FILINFO info = fno;
+        if (cb(nextPath, info))
+            return FileWalker::CONTINUE;
+        return (fno.fattrib & AM_DIR) ? FileWalker::PRUNE : FileWalker::SKIP_SIBLINGS;
+    });
+}
 
-    /* Get volume information and free clusters of drive 0 */
-    FRESULT res = f_getfree(path, &fre_clust, &fs);
+static void free_space_out(FATFS* fs, DWORD fre_clust, uint64_t* bytesFreeOut, uint64_t* bytesUsedOut, uint64_t* bytesTotalOut) {
+    DWORD fre_sect, tot_sect;
 
     /* Get total sectors and free sectors */
     tot_sect = (fs->n_fatent - 2) * fs->csize;
@@ -93,9 +156,51 @@ FRESULT f_getfree_out(uint8_t driveNumber, uint64_t* bytesFreeOut, uint64_t* byt
 
     if(bytesTotalOut)
     	*bytesTotalOut = totalBytes;
+}
+
+FRESULT f_getfree_out(uint8_t driveNumber, uint64_t* bytesFreeOut, uint64_t* bytesUsedOut, uint64_t* bytesTotalOut) {
+    FATFS *fs;
+    DWORD fre_clust;
+
+    char path[3];
+    path[0] = '0' + driveNumber;
+    path[1] = ':';
+    path[2] = 0;
+
+    /* Get volume information and free clusters of drive 0 */
+    FRESULT res = f_getfree(path, &fre_clust, &fs);
+    if(res != FR_OK)
+    	return res;
+
+    free_space_out(fs, fre_clust, bytesFreeOut, bytesUsedOut, bytesTotalOut);
+
+    return res;
+}
+
+#if _FS_GETFREE_NB
+//Non-blocking variant: each call scans a bounded part of the FAT and reports an estimate until the count is exact
+FRESULT f_getfree_out_nb(uint8_t driveNumber, uint64_t* bytesFreeOut, uint64_t* bytesUsedOut, uint64_t* bytesTotalOut, bool* exactOut) {
+    FATFS *fs;
+    DWORD fre_clust;
+    BYTE exact;
+
+    char path[3];
+    path[0] = '0' + driveNumber;
+    path[1] = ':';
+    path[2] = 0;
+
+    FRESULT res = f_getfree_nb(path, &fre_clust, &exact, &fs);
+    if(res != FR_OK)
+    	return res;
+
+    free_space_out(fs, fre_clust, bytesFreeOut, bytesUsedOut, bytesTotalOut);
+
+    if(exactOut)
+    	*exactOut = exact != 0;
 
     return res;
 }
+#endif
 
 //Print free space, adapted from FatFs documentation (http://elm-chan.org/fsw/ff/en/getfree.html)
 FRESULT print_free_space(uint8_t driveNumber, Print& print) {
@@ -2,6 +2,47 @@
 #define FATFS_UTILS_H
 
 #include "FatFs/FatFs.h"
+#include <type_traits>
+
+#define FILE_WALKER_MAX_DEPTH 8
+#define FILE_WALKER_MAX_PATH 256
+
+/*! \brief Iterative directory tree walker
+ *
+ *  Visits every object under a directory without recursion or heap allocation: the open
+ *  directories are kept on a stack of FILE_WALKER_MAX_DEPTH levels and the path of the current
+ *  object is built in a single buffer of FILE_WALKER_MAX_PATH characters, both inside the walker.
+ *  Files are reported once. Directories are reported before their contents (PRE_ORDER), after
+ *  them (POST_ORDER, with post set) or both. Returning PRUNE for a directory in pre-order skips
+ *  its contents, SKIP_SIBLINGS skips the rest of the directory the object is in and STOP ends the
+ *  walk with FR_OK. Each open level holds a file lock entry, so the depth is also limited by
+ *  _FS_LOCK. A sub-directory which is deeper than the stack or cannot be read, and an object
+ *  whose path does not fit in the buffer, are skipped with a logged error and the walk goes on;
+ *  walk() returns an error only for the root directory.
+ */
+class FileWalker {
+public:
+	enum Order { PRE_ORDER = 1, POST_ORDER = 2 };
+	enum Action { CONTINUE, PRUNE, SKIP_SIBLINGS, STOP };
+	typedef Action (*Callback)(void* context, const char* path, const FILINFO& info, bool post);
+
+	FRESULT walk(const char* root, Callback callback, void* context, uint8_t order = PRE_ORDER);
+
+	template<typename F>
+	FRESULT walk(const char* root, F&& callback, uint8_t order = PRE_ORDER)
+	{
+		typedef typename std::remove_reference<F>::type Function;
+		return walk(root, [](void* context, const char* path, const FILINFO& info, bool post) -> Action {
+			return (*static_cast<Function*>(context))(path, info, post);
+		}, const_cast<void*>(static_cast<const void*>(&callback)), order);
+	}
+private:
+	DIR _dirs[FILE_WALKER_MAX_DEPTH];
+	FILINFO _info[FILE_WALKER_MAX_DEPTH];
+	uint16_t _length[FILE_WALKER_MAX_DEPTH];
+	FILINFO _entry;
+	char _path[FILE_WALKER_MAX_PATH];
+};
 
 FRESULT scan_files (String path, Print& print);
 FRESULT scan_files (String path, std::function<bool(String&, FILINFO&)> cb);
@@ -10,6 +51,9 @@ FRESULT print_file_info(const char* path, Print& print);
 String bytesToPretty(uint64_t bytes);
 FRESULT f_append_string(String& path, String& str);
 FRESULT f_getfree_out(uint8_t driveNumber, uint64_t* bytesFreeOut, uint64_t* bytesUsedOut, uint64_t* bytesTotalOut);
+#if _FS_GETFREE_NB
+FRESULT f_getfree_out_nb(uint8_t driveNumber, uint64_t* bytesFreeOut, uint64_t* bytesUsedOut, uint64_t* bytesTotalOut, bool* exactOut);
+#endif
 
 #include "spark_wiring_logging.h"
 